@@ -0,0 +1,1672 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Name:        wx-config-bench.cpp
+// Purpose:     Benchmarks of wx-config-win against synthetic wxWidgets installations
+// Created:     2026-10-19
+// Licence:     wxWidgets licence
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// The benchmarks reuse the classes of wx-config itself, and count their allocations
+#define WXCONFIG_NO_MAIN
+#define WXCONFIG_COUNT_ALLOCATIONS
+#include "wx-config-win.cpp"
+
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/wait.h>
+#endif
+
+// -------------------------------------------------------------------------------------------------
+
+/// Creates a directory, returns false if it can't be created and doesn't exist
+bool makeDir(const std::string& path)
+{
+#ifdef _WIN32
+    if (_mkdir(path.c_str()) == 0)
+        return true;
+#else
+    if (mkdir(path.c_str(), 0755) == 0)
+        return true;
+#endif
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+bool removeDir(const std::string& path)
+{
+#ifdef _WIN32
+    return _rmdir(path.c_str()) == 0;
+#else
+    return rmdir(path.c_str()) == 0;
+#endif
+}
+
+unsigned long currentPid()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+unsigned long coreCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// A generated wxWidgets installation: include/wx/wx.h, build/msw/config.*, and
+/// lib/<cfg>/build.cfg plus lib/<cfg>/wx/setup.h for each of the configurations
+class SyntheticPrefix
+{
+public:
+    /// setupHDefines and setupHComments give the size of each setup.h: the number of
+    /// #define lines, and the comment lines before each of them
+    SyntheticPrefix(const std::string& root, size_t configs, size_t setupHDefines, size_t setupHComments)
+        : m_root(root), m_setupHLines(0), m_keep(false)
+    {
+        std::vector<std::string> all = matrix();
+        if (configs > all.size())
+            configs = all.size();
+        m_configs.assign(all.begin(), all.begin() + configs);
+
+        makeDirs(m_root);
+        write("include" PATH_SEP "wx" PATH_SEP "wx.h", "// wx.h\n");
+
+        static const char* compilers[] = { "gcc", "vc", "dmc", "wat", "bcc" };
+        for (size_t i = 0; i < sizeof(compilers) / sizeof(compilers[0]); ++i)
+            write(std::string("build" PATH_SEP "msw" PATH_SEP "config.") + compilers[i], configFile(compilers[i]));
+
+        for (std::vector<std::string>::const_iterator it = m_configs.begin(); it != m_configs.end(); ++it)
+            writeConfig(*it, buildCfg(*it), setupH(isUnicode(*it), setupHDefines, setupHComments));
+    }
+
+    ~SyntheticPrefix()
+    {
+        if (m_keep)
+            return;
+        for (std::vector<std::string>::reverse_iterator it = m_files.rbegin(); it != m_files.rend(); ++it)
+            remove(it->c_str());
+        for (std::vector<std::string>::reverse_iterator it = m_dirs.rbegin(); it != m_dirs.rend(); ++it)
+            removeDir(*it);
+    }
+
+    /// Every configuration that can be generated, ordered so that the first ones already
+    /// cover all the compilers: vc_lib\msw, dmc_lib\msw, ..., vc_dll\msw, ..., vc_lib\mswu, ...
+    /// The default gcc_dll\msw comes 10th, so smaller prefixes go through the autodetection
+    static std::vector<std::string> matrix()
+    {
+        static const char* flavours[] = { "msw", "mswu", "mswd", "mswud", "mswuniv", "mswunivu", "mswunivd", "mswunivud" };
+        static const char* types[] = { "lib", "dll" };
+        static const char* compilers[] = { "vc", "dmc", "wat", "bcc", "gcc" };
+
+        std::vector<std::string> cfgs;
+        for (size_t f = 0; f < sizeof(flavours) / sizeof(flavours[0]); ++f)
+            for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t)
+                for (size_t c = 0; c < sizeof(compilers) / sizeof(compilers[0]); ++c)
+                    cfgs.push_back(std::string(compilers[c]) + "_" + types[t] + PATH_SEP + flavours[f]);
+        return cfgs;
+    }
+
+    /// Adds a configuration with the given build.cfg and setup.h
+    void addConfig(const std::string& cfg, const std::string& buildCfgText, const std::string& setupHText)
+    {
+        m_configs.push_back(cfg);
+        writeConfig(cfg, buildCfgText, setupHText);
+    }
+
+    /// Drops the generated files from the page cache, so that they are read from the disk
+    /// again; false where that isn't possible, outside Linux. The dentries and inodes of
+    /// the files stay cached: only root can drop them (/proc/sys/vm/drop_caches)
+    bool evict() const
+    {
+#ifdef __linux__
+        for (std::vector<std::string>::const_iterator it = m_files.begin(); it != m_files.end(); ++it)
+        {
+            int fd = ::open(it->c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            /// the dirty pages, just written, would stay
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// Leaves the generated files on disk, for inspection
+    void keep()
+    {
+        m_keep = true;
+    }
+
+    const std::string& root() const
+    {
+        return m_root;
+    }
+
+    const std::vector<std::string>& configs() const
+    {
+        return m_configs;
+    }
+
+    /// Lines of each setup.h
+    size_t setupHLines() const
+    {
+        return m_setupHLines;
+    }
+
+    /// Contents of a setup.h with the given number of #define lines, each of them after
+    /// a block of comments, and the flags read by wx-config among them
+    static std::string setupH(bool unicode, size_t defines, size_t comments)
+    {
+        static const char* used[] = { "wxUSE_ZLIB 1", "wxUSE_REGEX 1", "wxUSE_LIBPNG 1", "wxUSE_LIBJPEG 1",
+                                      "wxUSE_LIBTIFF 1", "wxUSE_XRC 1", "wxUSE_OLE 1", "wxUSE_SOCKETS 1",
+                                      "wxUSE_ODBC 0", "wxUSE_UNICODE_MSLU 0" };
+        const size_t usedCount = sizeof(used) / sizeof(used[0]);
+
+        std::string text;
+        text += "/////////////////////////////////////////////////////////////////////////////\n";
+        text += "// Name:        wx/msw/setup.h\n";
+        text += "/////////////////////////////////////////////////////////////////////////////\n\n";
+        text += "#ifndef _WX_SETUP_H_\n#define _WX_SETUP_H_\n\n";
+        text += unicode ? "#define wxUSE_UNICODE 1\n" : "#define wxUSE_UNICODE 0\n";
+
+        char line[128];
+        for (size_t i = 0; i < defines; ++i)
+        {
+            for (size_t j = 0; j < comments; ++j)
+            {
+                sprintf(line, "// Option %lu: comment line %lu describing the option and its default\n",
+                        (unsigned long)i, (unsigned long)j);
+                text += line;
+            }
+            text += "//\n// Default is 1\n";
+            if (i < usedCount)
+                sprintf(line, "#define %s\n\n", used[i]);
+            else
+                sprintf(line, "#   define\twxUSE_SYNTHETIC_OPTION_%lu %d\n\n", (unsigned long)i, (int)(i % 2));
+            text += line;
+        }
+        text += "#endif // _WX_SETUP_H_\n";
+        return text;
+    }
+
+    static std::string configFile(const std::string& compiler)
+    {
+        return "# =========================================================================\n"
+               "# config." + compiler + "\n"
+               "# =========================================================================\n\n"
+               "# C compiler\nCC = " + compiler + "\n\n"
+               "# C++ compiler\nCXX = " + compiler + "++\n\n"
+               "CFLAGS = \nCXXFLAGS = \nCPPFLAGS = \nLDFLAGS = \n\n"
+               "# What type of library to build? [0,1]\nSHARED = 0\n\n"
+               "CFG = \n";
+    }
+
+    /// The [u][d] suffix of a configuration, as in 'gcc_dll\mswunivud'
+    static std::string suffix(const std::string& cfg)
+    {
+        std::string flavour = cfg.substr(cfg.find(PATH_SEP) + 1);
+        return flavour.substr(isUniversal(cfg) ? 7 : 3);
+    }
+
+    static bool isUniversal(const std::string& cfg)
+    {
+        return cfg.find("univ") != std::string::npos;
+    }
+
+    static bool isUnicode(const std::string& cfg)
+    {
+        return suffix(cfg).find('u') != std::string::npos;
+    }
+
+    static bool isDebug(const std::string& cfg)
+    {
+        return suffix(cfg).find('d') != std::string::npos;
+    }
+
+    static std::string buildCfg(const std::string& cfg)
+    {
+        std::string compiler = cfg.substr(0, cfg.find('_'));
+        bool shared = cfg.find("_dll") != std::string::npos;
+
+        std::string text;
+        text += "WXVER_MAJOR=2\nWXVER_MINOR=8\nWXVER_RELEASE=7\n";
+        text += std::string("BUILD=") + (isDebug(cfg) ? "debug" : "release") + "\n";
+        text += "MONOLITHIC=0\n";
+        text += std::string("SHARED=") + (shared ? "1" : "0") + "\n";
+        text += std::string("UNICODE=") + (isUnicode(cfg) ? "1" : "0") + "\n";
+        text += std::string("WXUNIV=") + (isUniversal(cfg) ? "1" : "0") + "\n";
+        text += "CFG=\nVENDOR=custom\nOFFICIAL_BUILD=0\nDEBUG_FLAG=default\nDEBUG_INFO=default\n";
+        text += "DEBUG_RUNTIME_LIBS=default\nRUNTIME_LIBS=dynamic\nMSLU=0\nUSE_EXCEPTIONS=1\nUSE_RTTI=1\n";
+        text += "USE_THREADS=1\nUSE_GUI=1\nUSE_HTML=1\nUSE_MEDIA=1\nUSE_XRC=1\nUSE_AUI=1\nUSE_OPENGL=1\n";
+        text += "USE_ODBC=0\nUSE_QA=1\nUSE_GDIPLUS=0\n";
+        text += "COMPILER=" + compiler + "\nCPPFLAGS=\nLDFLAGS=\nCXXFLAGS=\n";
+        return text;
+    }
+
+protected:
+    void makeDirs(const std::string& path)
+    {
+        size_t pos = 0;
+        while (pos != std::string::npos)
+        {
+            pos = path.find(PATH_SEP, pos + 1);
+            std::string dir = path.substr(0, pos);
+            struct stat st;
+            if (stat(dir.c_str(), &st) != 0)
+            {
+                if (!makeDir(dir))
+                {
+                    std::cout << g_tokError << "Unable to create the directory '" << dir << "'." << std::endl;
+                    exit(1);
+                }
+                m_dirs.push_back(dir);
+            }
+        }
+    }
+
+    void writeConfig(const std::string& cfg, const std::string& buildCfgText, const std::string& setupHText)
+    {
+        std::string dir = "lib" PATH_SEP + cfg;
+        write(dir + PATH_SEP "build.cfg", buildCfgText);
+        write(dir + PATH_SEP "wx" PATH_SEP "setup.h", setupHText);
+    }
+
+    void write(const std::string& relative, const std::string& text)
+    {
+        std::string path = m_root + PATH_SEP + relative;
+        makeDirs(path.substr(0, path.rfind(PATH_SEP)));
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file || fwrite(text.data(), 1, text.size(), file) != text.size())
+        {
+            std::cout << g_tokError << "Unable to write the file '" << path << "'." << std::endl;
+            exit(1);
+        }
+        fclose(file);
+        m_files.push_back(path);
+
+        if (relative.find("setup.h") != std::string::npos)
+            m_setupHLines = std::count(text.begin(), text.end(), '\n');
+    }
+
+    std::string m_root;
+    std::vector<std::string> m_configs;
+    std::vector<std::string> m_files;
+    std::vector<std::string> m_dirs;
+    size_t m_setupHLines;
+    bool m_keep;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// A child process running wx-config, with its output and its errors discarded or
+/// saved to files
+class ChildProcess
+{
+public:
+    ChildProcess() : m_start(0), m_elapsed(0), m_exitCode(-1)
+    {
+#ifdef _WIN32
+        m_process = NULL;
+#else
+        m_pid = -1;
+#endif
+    }
+
+    bool start(const std::string& exe, const std::vector<std::string>& args, const std::string& errorFile = "",
+               const std::string& outputFile = "")
+    {
+        m_start = TimingTrace::now();
+#ifdef _WIN32
+        std::string cmdLine = "\"" + exe + "\"";
+        for (std::vector<std::string>::const_iterator it = args.begin(); it != args.end(); ++it)
+            cmdLine += " \"" + *it + "\"";
+
+        SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+        HANDLE nul = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, NULL);
+        HANDLE err = nul;
+        if (!errorFile.empty())
+            err = CreateFileA(errorFile.c_str(), GENERIC_WRITE, 0, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        HANDLE out = nul;
+        if (!outputFile.empty())
+            out = CreateFileA(outputFile.c_str(), GENERIC_WRITE, 0, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        STARTUPINFOA si;
+        ZeroMemory(&si, sizeof(si));
+        si.cb = sizeof(si);
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        si.hStdOutput = out;
+        si.hStdError = err;
+
+        PROCESS_INFORMATION pi;
+        std::vector<char> buffer(cmdLine.begin(), cmdLine.end());
+        buffer.push_back('\0');
+        BOOL ok = CreateProcessA(NULL, &buffer[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+        CloseHandle(nul);
+        if (err != nul)
+            CloseHandle(err);
+        if (out != nul)
+            CloseHandle(out);
+        if (!ok)
+            return false;
+
+        CloseHandle(pi.hThread);
+        m_process = pi.hProcess;
+        return true;
+#else
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(exe.c_str()));
+        for (std::vector<std::string>::const_iterator it = args.begin(); it != args.end(); ++it)
+            argv.push_back(const_cast<char*>(it->c_str()));
+        argv.push_back(NULL);
+
+        m_pid = fork();
+        if (m_pid == 0)
+        {
+            int nul = ::open("/dev/null", O_WRONLY);
+            int err = errorFile.empty() ? nul : ::open(errorFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            int out = outputFile.empty() ? nul : ::open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            dup2(out, 1);
+            dup2(err, 2);
+            execv(exe.c_str(), &argv[0]);
+            _exit(127);
+        }
+        return m_pid > 0;
+#endif
+    }
+
+    /// Waits for the end of the process, returns its exit code
+    int wait()
+    {
+#ifdef _WIN32
+        WaitForSingleObject(m_process, INFINITE);
+        finish();
+#else
+        int status = 0;
+        while (waitpid(m_pid, &status, 0) < 0)
+            if (errno != EINTR)
+                waitFailed();
+        finish(status);
+#endif
+        return m_exitCode;
+    }
+
+    /// Waits for the first of the running children to end, so that each one is timed
+    /// when it ends and not when its turn comes. Returns its index
+    static size_t waitAny(std::vector<ChildProcess>& children)
+    {
+        while (true)
+        {
+#ifdef _WIN32
+            /// WaitForMultipleObjects is limited to 64 handles, the others are polled
+            std::vector<HANDLE> handles;
+            std::vector<size_t> indexes;
+            for (size_t i = 0; i < children.size(); ++i)
+            {
+                if (children[i].m_process)
+                {
+                    handles.push_back(children[i].m_process);
+                    indexes.push_back(i);
+                }
+            }
+            for (size_t first = 0; first < handles.size(); first += MAXIMUM_WAIT_OBJECTS)
+            {
+                DWORD count = (DWORD)std::min(handles.size() - first, (size_t)MAXIMUM_WAIT_OBJECTS);
+                DWORD timeout = handles.size() > MAXIMUM_WAIT_OBJECTS ? 1 : INFINITE;
+                DWORD result = WaitForMultipleObjects(count, &handles[first], FALSE, timeout);
+                if (result == WAIT_FAILED)
+                    waitFailed();
+                if (result < WAIT_OBJECT_0 + count)
+                {
+                    size_t index = indexes[first + result - WAIT_OBJECT_0];
+                    children[index].finish();
+                    return index;
+                }
+            }
+#else
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0 && errno != EINTR)
+                waitFailed();
+            for (size_t i = 0; i < children.size(); ++i)
+            {
+                if (children[i].m_pid == pid)
+                {
+                    children[i].finish(status);
+                    return i;
+                }
+            }
+#endif
+        }
+    }
+
+    /// A child which can't be waited for would make the benchmark wait forever
+    static void waitFailed()
+    {
+#ifdef _WIN32
+        std::cout << g_tokError << "Unable to wait for a child process (error " << GetLastError() << ")." << std::endl;
+#else
+        std::cout << g_tokError << "Unable to wait for a child process: " << strerror(errno) << "." << std::endl;
+#endif
+        exit(1);
+    }
+
+    int exitCode() const
+    {
+        return m_exitCode;
+    }
+
+    /// Wall time from the start to the end of the process, in microseconds
+    double elapsed() const
+    {
+        return m_elapsed;
+    }
+
+protected:
+#ifdef _WIN32
+    void finish()
+    {
+        m_elapsed = TimingTrace::now() - m_start;
+        DWORD code = 1;
+        GetExitCodeProcess(m_process, &code);
+        CloseHandle(m_process);
+        m_process = NULL;
+        m_exitCode = code;
+    }
+#else
+    void finish(int status)
+    {
+        m_elapsed = TimingTrace::now() - m_start;
+        m_exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        m_pid = -1;
+    }
+#endif
+
+#ifdef _WIN32
+    HANDLE m_process;
+#else
+    pid_t m_pid;
+#endif
+    double m_start;
+    double m_elapsed;
+    int m_exitCode;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Latency samples of a scenario, in microseconds
+class Samples
+{
+public:
+    Samples() : m_sorted(true) {}
+
+    void add(double sample)
+    {
+        m_samples.push_back(sample);
+        m_sorted = false;
+    }
+
+    size_t count() const
+    {
+        return m_samples.size();
+    }
+
+    /// Nearest-rank percentile, q in [0,1]
+    double percentile(double q)
+    {
+        if (m_samples.empty())
+            return 0;
+        if (!m_sorted)
+            std::sort(m_samples.begin(), m_samples.end());
+        m_sorted = true;
+
+        size_t rank = (size_t)(q * m_samples.size());
+        if (rank >= m_samples.size())
+            rank = m_samples.size() - 1;
+        return m_samples[rank];
+    }
+
+    static void printHeader()
+    {
+        printf("  %-28s %6s %9s %9s %9s %9s %9s\n", "scenario (ms)", "runs", "min", "p50", "p90", "p99", "max");
+    }
+
+    void print(const std::string& name)
+    {
+        printf("  %-28s %6lu %9.3f %9.3f %9.3f %9.3f %9.3f\n", name.c_str(), (unsigned long)count(),
+               percentile(0) / 1000.0, percentile(0.5) / 1000.0, percentile(0.9) / 1000.0,
+               percentile(0.99) / 1000.0, percentile(1) / 1000.0);
+    }
+
+protected:
+    std::vector<double> m_samples;
+    bool m_sorted;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Benchmark settings, from the command line
+struct BenchOptions
+{
+    std::string exe;
+    std::string dir;
+    size_t runs;
+    size_t coldRuns;
+    std::vector<size_t> configs;
+    bool realistic;
+    bool extreme;
+    std::vector<size_t> jobs;
+    bool autodetect;
+    std::vector<size_t> threads;
+};
+
+/// The --name=value arguments of the benchmarks, which wx-config doesn't know
+class BenchArgs : public Options
+{
+public:
+    BenchArgs(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            size_t sep = arg.find('=');
+            (*this)[arg.substr(0, sep)] = sep == std::string::npos ? "" : arg.substr(sep + 1);
+        }
+    }
+};
+
+/// Typical invocations: args of wx-config after the --prefix
+struct Scenario
+{
+    const char* name;
+    const char* args[3];
+    bool explicitCfg;
+};
+
+static const Scenario g_scenarios[] =
+{
+    { "--cflags",                 { "--cflags", NULL, NULL },         true  },
+    { "--libs std",               { "--libs", "std", NULL },          true  },
+    { "--libs base,net",          { "--libs", "base,net", NULL },     true  },
+    { "--cflags, no --wxcfg",     { "--cflags", NULL, NULL },         false },
+};
+
+std::vector<std::string> scenarioArgs(const Scenario& scenario, const SyntheticPrefix& prefix)
+{
+    std::vector<std::string> args;
+    args.push_back("--prefix=" + prefix.root());
+    if (scenario.explicitCfg)
+        args.push_back("--wxcfg=" + prefix.configs().front());
+    for (size_t i = 0; i < 3 && scenario.args[i]; ++i)
+        args.push_back(scenario.args[i]);
+    return args;
+}
+
+/// Runs the invocation once, exits if wx-config fails
+double runOnce(const std::string& exe, const std::vector<std::string>& args)
+{
+    ChildProcess child;
+    if (!child.start(exe, args) || child.wait() != 0)
+    {
+        std::cout << g_tokError << "Running '" << exe;
+        for (std::vector<std::string>::const_iterator it = args.begin(); it != args.end(); ++it)
+            std::cout << " " << *it;
+        std::cout << "' failed." << std::endl;
+        exit(1);
+    }
+    return child.elapsed();
+}
+
+/// Unique directory for a generated prefix
+std::string prefixDir(const BenchOptions& opts)
+{
+    static unsigned long serial = 0;
+    char name[64];
+    sprintf(name, "wx-config-bench-%lu-%lu", currentPid(), serial++);
+    return opts.dir + PATH_SEP + name;
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// End-to-end latency of the typical invocations, for each size of the prefix.
+/// Cold runs use a freshly generated prefix each, evicted from the page cache on Linux;
+/// elsewhere its files are still cached. Warm runs repeat the invocation on the same prefix
+void benchStartup(const BenchOptions& opts)
+{
+    struct Size
+    {
+        const char* name;
+        size_t defines;
+        size_t comments;
+        bool enabled;
+    };
+    const Size sizes[] =
+    {
+        { "realistic", 300, 4, opts.realistic },
+        { "extreme", 5000, 12, opts.extreme },
+    };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        if (!sizes[s].enabled)
+            continue;
+
+        for (std::vector<size_t>::const_iterator configs = opts.configs.begin(); configs != opts.configs.end(); ++configs)
+        {
+            SyntheticPrefix prefix(prefixDir(opts), *configs, sizes[s].defines, sizes[s].comments);
+            printf("\n%lu configuration(s), %s setup.h (%lu lines)\n", (unsigned long)prefix.configs().size(),
+                   sizes[s].name, (unsigned long)prefix.setupHLines());
+            Samples::printHeader();
+
+            for (size_t i = 0; i < sizeof(g_scenarios) / sizeof(g_scenarios[0]); ++i)
+            {
+                const Scenario& scenario = g_scenarios[i];
+
+                Samples cold;
+                for (size_t run = 0; run < opts.coldRuns; ++run)
+                {
+                    SyntheticPrefix fresh(prefixDir(opts), *configs, sizes[s].defines, sizes[s].comments);
+                    fresh.evict();
+                    cold.add(runOnce(opts.exe, scenarioArgs(scenario, fresh)));
+                }
+                cold.print(std::string(scenario.name) + " (cold)");
+
+                std::vector<std::string> args = scenarioArgs(scenario, prefix);
+                runOnce(opts.exe, args);
+
+                Samples warm;
+                for (size_t run = 0; run < opts.runs; ++run)
+                    warm.add(runOnce(opts.exe, args));
+                warm.print(std::string(scenario.name) + " (warm)");
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// File system operations of an invocation, read back from its --stats report
+struct FileOps
+{
+    FileOps() : probes(0), stats(0), reads(0), opens(0) {}
+
+    unsigned long probes;
+    unsigned long stats;
+    unsigned long reads;
+    unsigned long opens;
+
+    /// Parses the 'files probed N (H hits, M misses)' and 'files read ...' lines
+    bool parse(const std::string& path)
+    {
+        FILE* file = fopen(path.c_str(), "r");
+        if (!file)
+            return false;
+
+        char line[1024];
+        unsigned long count, hits, misses;
+        bool found = false;
+        while (fgets(line, sizeof(line), file))
+        {
+            if (sscanf(line, " files probed %lu (%lu hits, %lu misses)", &count, &hits, &misses) == 3)
+            {
+                probes += count;
+                stats += misses;
+                found = true;
+            }
+            else if (sscanf(line, " files read %lu (%lu hits, %lu misses)", &count, &hits, &misses) == 3)
+            {
+                reads += count;
+                opens += misses;
+            }
+        }
+        fclose(file);
+        return found;
+    }
+};
+
+/// Thundering herd at the start of a parallel build: rounds of N concurrent invocations,
+/// alternating --cflags and --libs, for each N. Reports the wall time of the rounds, the
+/// tail latency of the invocations, and the stat()/open calls they made (from --stats)
+void benchBurst(const BenchOptions& opts)
+{
+    SyntheticPrefix prefix(prefixDir(opts), opts.configs.front(), 300, 4);
+    printf("\n%lu configuration(s), %lu cores, %s\n", (unsigned long)prefix.configs().size(), coreCount(),
+           opts.autodetect ? "autodetected configuration" : "explicit --wxcfg");
+    printf("  %6s %7s %10s %10s %10s %10s %10s %10s %10s\n", "jobs", "rounds", "wall p50", "wall max",
+           "inv p50", "inv p90", "inv p99", "inv max", "fs ops/inv");
+
+    std::vector<std::string> base;
+    base.push_back("--prefix=" + prefix.root());
+    if (!opts.autodetect)
+        base.push_back("--wxcfg=" + prefix.configs().front());
+    base.push_back("--stats");
+
+    for (std::vector<size_t>::const_iterator jobs = opts.jobs.begin(); jobs != opts.jobs.end(); ++jobs)
+    {
+        Samples wall, invocations;
+        FileOps ops;
+        for (size_t round = 0; round < opts.runs; ++round)
+        {
+            std::vector<ChildProcess> children(*jobs);
+            std::vector<std::string> errorFiles(*jobs);
+
+            double start = TimingTrace::now();
+            for (size_t i = 0; i < *jobs; ++i)
+            {
+                std::vector<std::string> args(base);
+                if (i % 2 == 0)
+                    args.push_back("--cflags");
+                else
+                {
+                    args.push_back("--libs");
+                    args.push_back("std");
+                }
+
+                char suffix[32];
+                sprintf(suffix, ".stats-%lu", (unsigned long)i);
+                errorFiles[i] = prefix.root() + suffix;
+                if (!children[i].start(opts.exe, args, errorFiles[i]))
+                {
+                    std::cout << g_tokError << "Unable to run '" << opts.exe << "'." << std::endl;
+                    exit(1);
+                }
+            }
+
+            for (size_t running = *jobs; running > 0; --running)
+            {
+                ChildProcess& child = children[ChildProcess::waitAny(children)];
+                if (child.exitCode() != 0)
+                {
+                    std::cout << g_tokError << "An invocation of '" << opts.exe << "' failed." << std::endl;
+                    exit(1);
+                }
+                invocations.add(child.elapsed());
+            }
+            wall.add(TimingTrace::now() - start);
+
+            for (size_t i = 0; i < *jobs; ++i)
+            {
+                ops.parse(errorFiles[i]);
+                remove(errorFiles[i].c_str());
+            }
+        }
+
+        unsigned long total = (unsigned long)invocations.count();
+        printf("  %6lu %7lu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.1f\n", (unsigned long)*jobs,
+               (unsigned long)wall.count(), wall.percentile(0.5) / 1000.0, wall.percentile(1) / 1000.0,
+               invocations.percentile(0.5) / 1000.0, invocations.percentile(0.9) / 1000.0,
+               invocations.percentile(0.99) / 1000.0, invocations.percentile(1) / 1000.0,
+               total ? (double)(ops.stats + ops.opens) / total : 0.0);
+    }
+    printf("  (times in ms; fs ops are the stat() and open calls actually made)\n");
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Parses a build.cfg/config.* from memory
+struct BuildCfgParser
+{
+    void operator()(const TextView& text) const
+    {
+        BuildFileOptions cfg;
+        cfg.parse(text);
+    }
+};
+
+/// Parses a setup.h from memory, each line going through SetupHOptions::split
+struct SetupHParser
+{
+    void operator()(const TextView& text) const
+    {
+        SetupHOptions sho;
+        sho.parse(text);
+    }
+};
+
+/// Parses a command line, the libs in its last argument going through parseLibs
+struct CmdLineParser
+{
+    CmdLineParser(const std::string& args)
+    {
+        LineLexer lexer(TextView(args.data(), args.data() + args.size()));
+        TextView line;
+        while (lexer.next(line))
+            if (line.length())
+                m_args.push_back(std::string(line.begin, line.end));
+    }
+
+    void operator()(const TextView&) const
+    {
+        CmdLineOptions cl(m_args);
+    }
+
+    std::vector<std::string> m_args;
+};
+
+/// Runs the parser over the input for at least 200ms, and reports its throughput
+/// and the heap allocations it made for each line (or argument) of the input
+template <class Parser>
+void benchParser(const std::string& name, const std::string& input, const Parser& parser)
+{
+    TextView text(input.data(), input.data() + input.size());
+    size_t lines = std::count(input.begin(), input.end(), '\n');
+    if (lines == 0)
+        lines = 1;
+
+    parser(text);
+
+    unsigned long iterations = 0;
+    unsigned long allocations = g_stats.allocations;
+    double start = TimingTrace::now();
+    double elapsed = 0;
+    do
+    {
+        for (int i = 0; i < 10; ++i)
+            parser(text);
+        iterations += 10;
+        elapsed = TimingTrace::now() - start;
+    }
+    while (elapsed < 200000);
+    allocations = g_stats.allocations - allocations;
+
+    printf("  %-32s %9lu %7lu %9lu %10.1f %9.1f %9.2f\n", name.c_str(), (unsigned long)input.size(),
+           (unsigned long)lines, iterations, input.size() * (double)iterations / elapsed,
+           elapsed * 1000.0 / ((double)iterations * lines), (double)allocations / ((double)iterations * lines));
+}
+
+/// A build.cfg with the given number of KEY=VALUE lines, each after a comment
+std::string largeBuildCfg(size_t keys)
+{
+    std::string text;
+    char line[128];
+    for (size_t i = 0; i < keys; ++i)
+    {
+        sprintf(line, "# Option %lu, as written by the makefiles\nSYNTHETIC_OPTION_%lu = value %lu\n",
+                (unsigned long)i, (unsigned long)i, (unsigned long)i);
+        text += line;
+    }
+    return text;
+}
+
+/// Command line arguments, one per line, the last one holding the given number of libs
+std::string cmdLine(const std::string& args, size_t libs)
+{
+    std::string text = "wx-config\n" + args;
+    if (libs)
+    {
+        char lib[32];
+        for (size_t i = 0; i < libs; ++i)
+        {
+            sprintf(lib, "%slib%lu", i ? "," : "\n", (unsigned long)i);
+            text += lib;
+        }
+    }
+    return text + "\n";
+}
+
+/// Throughput of the parsers run by every invocation, on inputs in memory
+void benchParsers(const BenchOptions&)
+{
+    printf("\n  %-32s %9s %7s %9s %10s %9s %9s\n", "parser / input", "bytes", "lines", "runs", "MB/s",
+           "ns/line", "allocs/line");
+
+    BuildCfgParser buildCfg;
+    benchParser("build.cfg minimal", std::string("BUILD=debug\nSHARED=1\nUNICODE=1\n"), buildCfg);
+    benchParser("build.cfg realistic", SyntheticPrefix::buildCfg("gcc_dll" PATH_SEP "mswud"), buildCfg);
+    benchParser("config.gcc realistic", SyntheticPrefix::configFile("gcc"), buildCfg);
+    benchParser("build.cfg 2000 keys", largeBuildCfg(2000), buildCfg);
+
+    SetupHParser setupH;
+    benchParser("setup.h minimal", SyntheticPrefix::setupH(true, 10, 0), setupH);
+    benchParser("setup.h realistic", SyntheticPrefix::setupH(true, 300, 4), setupH);
+    benchParser("setup.h 800 defines", SyntheticPrefix::setupH(true, 800, 0), setupH);
+    benchParser("setup.h 5000 defines, comments", SyntheticPrefix::setupH(true, 5000, 12), setupH);
+
+    benchParser("cmdline --cflags", std::string("wx-config\n--cflags\n"), CmdLineParser("wx-config\n--cflags\n"));
+    std::string typical = cmdLine("--prefix=C:\\wxWidgets\n--wxcfg=gcc_dll\\mswud\n--libs\nstd", 0);
+    benchParser("cmdline --libs std", typical, CmdLineParser(typical));
+    std::string libs = cmdLine("--prefix=C:\\wxWidgets\n--wxcfg=gcc_dll\\mswud\n--libs", 200);
+    benchParser("cmdline --libs with 200 libs", libs, CmdLineParser(libs));
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Allocations and peak heap of a full resolution, from detectCompiler() to outputFlags()
+struct AllocationCost
+{
+    unsigned long allocations;
+    unsigned long peak;
+};
+
+/// Resolves in process, as resolveQuery() does once the prefix and the configuration are
+/// known. Each resolution has its own context, so that it is measured as a first one
+AllocationCost resolve(const std::string& prefix, const std::string& cfg, const std::vector<std::string>& args, FILE* out)
+{
+    std::vector<std::string> argStrings;
+    argStrings.push_back("wx-config");
+    argStrings.insert(argStrings.end(), args.begin(), args.end());
+
+    RunContext ctx;
+    WxConfigResult result;
+    CmdLineOptions cl(argStrings);
+    Options po;
+    po["prefix"] = prefix;
+    po["wxcfg"] = cfg;
+    po["wxcfgfile"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + po["wxcfg"] + PATH_SEP "build.cfg";
+    po["wxcfgsetuphfile"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + po["wxcfg"] + PATH_SEP "wx" PATH_SEP "setup.h";
+    validateConfiguration(ctx, po["wxcfgfile"], po["wxcfgsetuphfile"]);
+
+    unsigned long allocations = g_stats.allocations;
+    unsigned long heap = g_stats.heapBytes;
+    g_stats.heapPeak = heap;
+
+    detectCompiler(ctx, po, cl);
+    outputFlags(ctx, po, cl, result);
+
+    AllocationCost cost;
+    cost.allocations = g_stats.allocations - allocations;
+    cost.peak = g_stats.heapPeak - heap;
+
+    fwrite(result.output.data(), 1, result.output.size(), out);
+    return cost;
+}
+
+/// The toolchain the budgets are valid for: the allocations depend on the compiler, on the
+/// C++ standard and on the standard library. Without spaces, which build.cfg values lose
+std::string budgetsToolchain()
+{
+    char text[256];
+#if defined(__GNUC__)
+    sprintf(text, "gcc-%s", __VERSION__);
+#elif defined(_MSC_VER)
+    sprintf(text, "vc-%d", _MSC_VER);
+#else
+    sprintf(text, "unknown");
+#endif
+#if defined(_MSVC_LANG)
+    sprintf(text + strlen(text), "/c++%ld", (long)_MSVC_LANG);
+#else
+    sprintf(text + strlen(text), "/c++%ld", (long)__cplusplus);
+#endif
+#if defined(_GLIBCXX_USE_CXX11_ABI)
+    strcat(text, _GLIBCXX_USE_CXX11_ABI ? "/libstdc++-cxx11" : "/libstdc++-cow");
+#elif defined(_LIBCPP_VERSION)
+    strcat(text, "/libc++");
+#endif
+
+    std::string toolchain(text);
+    toolchain.erase(std::remove(toolchain.begin(), toolchain.end(), ' '), toolchain.end());
+    return toolchain;
+}
+
+/// Allocation budgets of the resolution path: every backend, in its static and shared
+/// configurations, with each kind of output. Fails when a scenario allocates more, or
+/// reaches a higher peak heap, than the budget recorded in the budgets file
+int benchBudgets(const BenchOptions& opts, const std::string& budgetsFile, bool record)
+{
+    static const char* outputs[][2] =
+    {
+        { "--cflags", NULL },
+        { "--libs", NULL },
+        { "--libs", "base,net" },
+        { "--rcflags", NULL },
+        { "--release", "--basename" },
+    };
+
+    SyntheticPrefix prefix(prefixDir(opts), 10, 300, 4);
+#ifdef _WIN32
+    FILE* out = fopen("NUL", "w");
+#else
+    FILE* out = fopen("/dev/null", "w");
+#endif
+
+    RunContext ctx;
+    BuildFileOptions budgets;
+    if (!record)
+    {
+        TextView text;
+        if (!ctx.files.contents(budgetsFile, text) || !budgets.parse(text))
+        {
+            std::cout << g_tokError << "Unable to read the budgets from '" << budgetsFile << "'." << std::endl;
+            return 1;
+        }
+        if (budgets["toolchain"] != budgetsToolchain())
+        {
+            std::cout << g_tokError << "The budgets were recorded with " << budgets["toolchain"] << ", not with "
+                      << budgetsToolchain() << "." << std::endl;
+            std::cerr << "Build the bench as they were recorded, or record them again with --record." << std::endl;
+            return 1;
+        }
+    }
+
+    std::string recorded;
+    recorded += "# Allocation budgets of a full resolution, from detectCompiler() to outputFlags(),\n";
+    recorded += "# checked by 'wx-config-bench budgets' and written by 'wx-config-bench budgets --record'.\n";
+    recorded += "# <configuration>:<arguments>.allocs = heap allocations\n";
+    recorded += "# <configuration>:<arguments>.peak = peak heap, in bytes\n";
+    recorded += "# They are only checked by a bench built with the toolchain (compiler/C++ standard/\n";
+    recorded += "# standard library) they were recorded with.\n";
+    recorded += "toolchain = " + budgetsToolchain() + "\n";
+
+    printf("\n  %-36s %8s %8s %9s %9s  %s\n", "scenario", "allocs", "budget", "peak", "budget", "");
+    int failures = 0;
+    for (std::vector<std::string>::const_iterator cfg = prefix.configs().begin(); cfg != prefix.configs().end(); ++cfg)
+    {
+        for (size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); ++i)
+        {
+            std::vector<std::string> args;
+            std::string name = *cfg;
+            std::replace(name.begin(), name.end(), '\\', '/');
+            for (size_t j = 0; j < 2 && outputs[i][j]; ++j)
+            {
+                args.push_back(outputs[i][j]);
+                name += std::string(":") + outputs[i][j];
+            }
+
+            AllocationCost cost = resolve(prefix.root(), *cfg, args, out);
+
+            char line[256];
+            if (record)
+            {
+                /// 10% of headroom, for the variations of the paths and of the allocator
+                sprintf(line, "%s.allocs = %lu\n%s.peak = %lu\n", name.c_str(), cost.allocations + cost.allocations / 10 + 1,
+                        name.c_str(), cost.peak + cost.peak / 10 + 1);
+                recorded += line;
+                printf("  %-36s %8lu %8s %9lu %9s  recorded\n", name.c_str(), cost.allocations, "", cost.peak, "");
+                continue;
+            }
+
+            if (!budgets.keyExists(name + ".allocs") || !budgets.keyExists(name + ".peak"))
+            {
+                printf("  %-36s %8lu %8s %9lu %9s  NO BUDGET\n", name.c_str(), cost.allocations, "-", cost.peak, "-");
+                ++failures;
+                continue;
+            }
+
+            unsigned long allocsBudget = strtoul(budgets[name + ".allocs"].c_str(), NULL, 10);
+            unsigned long peakBudget = strtoul(budgets[name + ".peak"].c_str(), NULL, 10);
+            bool ok = cost.allocations <= allocsBudget && cost.peak <= peakBudget;
+            if (!ok)
+                ++failures;
+            printf("  %-36s %8lu %8lu %9lu %9lu  %s\n", name.c_str(), cost.allocations, allocsBudget,
+                   cost.peak, peakBudget, ok ? "ok" : "OVER BUDGET");
+        }
+    }
+    fclose(out);
+
+    if (record)
+    {
+        FILE* file = fopen(budgetsFile.c_str(), "wb");
+        if (!file || fwrite(recorded.data(), 1, recorded.size(), file) != recorded.size())
+        {
+            std::cout << g_tokError << "Unable to write the budgets to '" << budgetsFile << "'." << std::endl;
+            return 1;
+        }
+        fclose(file);
+        printf("\nBudgets written to '%s'.\n", budgetsFile.c_str());
+        return 0;
+    }
+
+    if (failures)
+    {
+        std::cout << g_tokError << failures << " scenario(s) over their allocation budget." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Scaling of autodetectConfiguration(), run in process as main() does when the default
+/// configuration is missing, with the number of configurations under lib and the number
+/// of --universal/--unicode/--debug/--static/--compiler options left to the autodetection.
+/// The options given select the first configuration of the prefix (vc_lib\msw).
+/// Cold runs use a freshly generated prefix, evicted from the page cache where possible
+/// (the "fresh ms" column otherwise: its files are still cached), warm runs repeat on the
+/// same one; each run has its own context, and so an empty file cache
+void benchAutodetect(const BenchOptions& opts)
+{
+    static const char* options[][2] =
+    {
+        { "--universal", "--universal=no" },
+        { "--unicode", "--unicode=no" },
+        { "--debug", "--debug=no" },
+        { "--static", "--static=yes" },
+        { "--compiler", "--compiler=vc" },
+    };
+    const size_t optionCount = sizeof(options) / sizeof(options[0]);
+
+    /// the eviction is tried once, on a prefix of the size of the first runs
+    bool evicts = SyntheticPrefix(prefixDir(opts), 1, 10, 0).evict();
+    printf("\n  %7s %-52s %10s %8s %7s %7s %9s %9s %9s\n", "configs", "omitted", "candidates", "distinct",
+           "probes", "stats", evicts ? "cold ms" : "fresh ms", "warm p50", "warm max");
+
+    g_stats.enabled = true;
+
+    for (std::vector<size_t>::const_iterator configs = opts.configs.begin(); configs != opts.configs.end(); ++configs)
+    {
+        SyntheticPrefix prefix(prefixDir(opts), *configs, 10, 0);
+
+        for (size_t omitted = 0; omitted <= optionCount; ++omitted)
+        {
+            std::vector<std::string> args;
+            args.push_back("wx-config");
+            std::string omittedNames;
+            for (size_t i = 0; i < optionCount; ++i)
+            {
+                if (i < omitted)
+                    omittedNames += std::string(omittedNames.empty() ? "" : " ") + options[i][0];
+                else
+                    args.push_back(options[i][1]);
+            }
+            args.push_back("--cflags");
+
+            CmdLineOptions cl(args);
+
+            Samples cold, warm;
+            unsigned long candidates = 0, distinct = 0, probes = 0, stats = 0;
+            for (size_t run = 0; run < opts.coldRuns + opts.runs; ++run)
+            {
+                bool isCold = run < opts.coldRuns;
+                SyntheticPrefix* fresh = isCold ? new SyntheticPrefix(prefixDir(opts), *configs, 10, 0) : NULL;
+                if (fresh)
+                    fresh->evict();
+
+                Options po;
+                po["prefix"] = fresh ? fresh->root() : prefix.root();
+                po["wxcfg"] = "gcc_dll" PATH_SEP "msw";
+                checkAdditionalFlags(po, cl);
+
+                RunContext ctx;
+                g_stats.candidates = g_stats.distinctCandidates = 0;
+
+                double start = TimingTrace::now();
+                autodetectConfiguration(ctx, po, cl);
+                double elapsed = TimingTrace::now() - start;
+
+                (isCold ? cold : warm).add(elapsed);
+
+                candidates = g_stats.candidates;
+                distinct = g_stats.distinctCandidates;
+                ctx.files.probeCounts(probes, stats);
+                delete fresh;
+            }
+
+            printf("  %7lu %-52s %10lu %8lu %7lu %7lu %9.3f %9.3f %9.3f\n", (unsigned long)prefix.configs().size(),
+                   omittedNames.empty() ? "(none)" : omittedNames.c_str(), candidates, distinct, probes, stats,
+                   cold.percentile(0.5) / 1000.0, warm.percentile(0.5) / 1000.0, warm.percentile(1) / 1000.0);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Resolutions done by one thread of the threads mode
+struct ResolveWork
+{
+    const std::vector<WxConfigQuery>* queries;
+    const std::vector<std::string>* expected;   ///< outputs of the single threaded resolutions
+    size_t runs;
+    WxConfigCache* cache;                       ///< NULL to parse the files in each resolution
+    size_t mismatches;
+};
+
+void resolveWorker(void* arg)
+{
+    ResolveWork& work = *(ResolveWork*)arg;
+    for (size_t run = 0; run < work.runs; ++run)
+    {
+        for (size_t i = 0; i < work.queries->size(); ++i)
+        {
+            WxConfigResult result = work.cache ? wxConfigResolve((*work.queries)[i], *work.cache)
+                                               : wxConfigResolve((*work.queries)[i]);
+            if (!result.ok() || result.output != (*work.expected)[i])
+                ++work.mismatches;
+        }
+    }
+}
+
+/// Throughput of in-process resolutions over a workspace, as a build driver linking the
+/// resolver does them: each thread resolves every configuration of the prefix with each
+/// kind of output, --runs times. With a WxConfigCache shared by the threads, the files
+/// are parsed once and then read without locking; without, each resolution parses its
+/// own. Fails if a concurrent resolution gives another output than a single threaded one
+int benchThreads(const BenchOptions& opts)
+{
+    static const char* outputs[][2] =
+    {
+        { "--cflags", NULL },
+        { "--libs", NULL },
+        { "--libs", "base,net" },
+    };
+
+    SyntheticPrefix prefix(prefixDir(opts), 10, 300, 4);
+
+    std::vector<WxConfigQuery> queries;
+    std::vector<std::string> expected;
+    for (std::vector<std::string>::const_iterator cfg = prefix.configs().begin(); cfg != prefix.configs().end(); ++cfg)
+    {
+        for (size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); ++i)
+        {
+            WxConfigQuery query;
+            query.args.push_back("--prefix=" + prefix.root());
+            query.args.push_back("--wxcfg=" + *cfg);
+            for (size_t j = 0; j < 2 && outputs[i][j]; ++j)
+                query.args.push_back(outputs[i][j]);
+            queries.push_back(query);
+            expected.push_back(wxConfigResolve(query).output);
+        }
+    }
+
+    /// the allocation counters would be written by every thread
+    g_stats.concurrent = true;
+
+    printf("\n  %-8s %7s %12s %10s %14s %8s\n", "cache", "threads", "resolutions", "ms", "resolutions/s", "speedup");
+    size_t mismatches = 0;
+    for (int shared = 0; shared < 2; ++shared)
+    {
+        double base = 0;
+        for (std::vector<size_t>::const_iterator threads = opts.threads.begin(); threads != opts.threads.end(); ++threads)
+        {
+            WxConfigCache cache;
+            std::vector<ResolveWork> work(*threads);
+            for (size_t t = 0; t < work.size(); ++t)
+            {
+                work[t].queries = &queries;
+                work[t].expected = &expected;
+                work[t].runs = opts.runs;
+                work[t].cache = shared ? &cache : NULL;
+                work[t].mismatches = 0;
+            }
+
+            double start = TimingTrace::now();
+            std::vector<Thread*> running;
+            for (size_t t = 0; t < work.size(); ++t)
+            {
+                running.push_back(new Thread(resolveWorker, &work[t]));
+                if (!running.back()->started())
+                {
+                    std::cout << g_tokError << "Unable to start " << work.size() << " threads." << std::endl;
+                    exit(1);
+                }
+            }
+            for (size_t t = 0; t < running.size(); ++t)
+            {
+                running[t]->join();
+                delete running[t];
+                mismatches += work[t].mismatches;
+            }
+            double elapsed = TimingTrace::now() - start;
+
+            unsigned long resolutions = (unsigned long)(*threads * opts.runs * queries.size());
+            double rate = resolutions / (elapsed / 1000000.0);
+            if (base == 0)
+                base = rate / *threads;
+            printf("  %-8s %7lu %12lu %10.1f %14.0f %7.2fx\n", shared ? "shared" : "none", (unsigned long)*threads,
+                   resolutions, elapsed / 1000.0, rate, rate / base);
+        }
+    }
+
+    g_stats.concurrent = false;
+
+    if (mismatches)
+    {
+        std::cout << g_tokError << mismatches << " concurrent resolution(s) differ from the single threaded ones." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Pseudo-random numbers from the LCG of the C standard, so that a corpus is the same
+/// on every platform for a given seed
+class Random
+{
+public:
+    Random(unsigned long seed) : m_state(seed) {}
+
+    /// A number in [0, n)
+    size_t next(size_t n)
+    {
+        m_state = (m_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+        return (size_t)((m_state >> 16) % n);
+    }
+
+    template <class T, size_t N>
+    const T& pick(const T (&values)[N])
+    {
+        return values[next(N)];
+    }
+
+protected:
+    unsigned long m_state;
+};
+
+/// A configuration of the differential corpus, and the queries run against it
+struct CorpusCase
+{
+    std::string cfg;
+    std::string buildCfg;
+    std::string setupH;
+    std::vector<std::vector<std::string> > queries;
+};
+
+/// Generates the case 'index' of the corpus: the backends come in turn, every build.cfg
+/// key and setup.h feature read by wx-config takes a random value, and the lib lists are
+/// random subsets of the known libs
+CorpusCase generateCase(size_t index, Random& random)
+{
+    static const char* compilers[] = { "vc", "dmc", "wat", "bcc", "gcc" };
+    static const char* bools[] = { "0", "1" };
+    static const char* defaults[] = { "default", "0", "1" };
+    static const char* bcfgBools[] = { "MONOLITHIC", "OFFICIAL_BUILD", "MSLU", "USE_EXCEPTIONS", "USE_RTTI",
+                                       "USE_THREADS", "USE_GUI", "USE_HTML", "USE_MEDIA", "USE_XRC", "USE_AUI",
+                                       "USE_OPENGL", "USE_ODBC", "USE_QA", "USE_GDIPLUS" };
+    static const char* features[] = { "wxUSE_ZLIB", "wxUSE_REGEX", "wxUSE_LIBPNG", "wxUSE_LIBJPEG", "wxUSE_LIBTIFF",
+                                      "wxUSE_XRC", "wxUSE_OLE", "wxUSE_SOCKETS", "wxUSE_ODBC", "wxUSE_UNICODE_MSLU",
+                                      "wxUSE_XML", "wxUSE_GRAPHICS_CONTEXT" };
+    static const char* defines[] = { "#define ", "#   define\t", "#define\t" };
+    static const char* libs[] = { "std", "base", "net", "xml", "core", "adv", "qa", "xrc", "aui", "html", "media",
+                                  "odbc", "dbgrid", "opengl", "gl" };
+
+    std::string compiler = compilers[index % (sizeof(compilers) / sizeof(compilers[0]))];
+    bool shared = random.next(2) != 0;
+    bool universal = random.next(2) != 0;
+    bool unicode = random.next(2) != 0;
+    bool debug = random.next(2) != 0;
+
+    CorpusCase c;
+    c.cfg = compiler + (shared ? "_dll" : "_lib") + PATH_SEP "msw" + (universal ? "univ" : "") +
+            (unicode ? "u" : "") + (debug ? "d" : "");
+
+    std::string& b = c.buildCfg;
+    b += std::string("WXVER_MAJOR=2\nWXVER_MINOR=") + (random.next(2) ? "8" : "6") + "\n";
+    b += std::string("WXVER_RELEASE=") + (random.next(2) ? "7" : "0") + "\n";
+    b += std::string("BUILD=") + (debug ? "debug" : "release") + "\n";
+    b += std::string("SHARED=") + (shared ? "1" : "0") + "\n";
+    b += std::string("UNICODE=") + (unicode ? "1" : "0") + "\n";
+    b += std::string("WXUNIV=") + (universal ? "1" : "0") + "\n";
+    for (size_t i = 0; i < sizeof(bcfgBools) / sizeof(bcfgBools[0]); ++i)
+        b += std::string(bcfgBools[i]) + "=" + random.pick(bools) + "\n";
+    b += std::string("DEBUG_FLAG=") + random.pick(defaults) + "\n";
+    b += std::string("DEBUG_INFO=") + random.pick(defaults) + "\n";
+    b += std::string("DEBUG_RUNTIME_LIBS=") + random.pick(defaults) + "\n";
+    b += std::string("RUNTIME_LIBS=") + (random.next(2) ? "static" : "dynamic") + "\n";
+    b += std::string("TARGET_CPU=") + (random.next(3) == 0 ? "" : (random.next(2) ? "amd64" : "ia64")) + "\n";
+    b += std::string("CFG=") + (random.next(4) == 0 ? "custom" : "") + "\n";
+    b += std::string("VENDOR=") + (random.next(2) ? "custom" : "") + "\n";
+    b += std::string("WX_LIB_FLAVOUR=") + (random.next(4) == 0 ? "gl" : "") + "\n";
+    b += "COMPILER=" + compiler + "\n";
+    b += std::string("CPPFLAGS=") + (random.next(4) == 0 ? "-DCORPUS_CPPFLAGS" : "") + "\n";
+    b += std::string("CXXFLAGS=") + (random.next(4) == 0 ? "-DCORPUS_CXXFLAGS" : "") + "\n";
+    b += std::string("LDFLAGS=") + (random.next(4) == 0 ? "-LCORPUS_LDFLAGS" : "") + "\n";
+
+    std::string& h = c.setupH;
+    h += "#ifndef _WX_SETUP_H_\n#define _WX_SETUP_H_\n\n";
+    h += std::string("#define wxUSE_UNICODE ") + (unicode ? "1" : "0") + "\n";
+    for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); ++i)
+        h += random.pick(defines) + std::string(features[i]) + " " + random.pick(bools) + "\n";
+    h += "\n#endif // _WX_SETUP_H_\n";
+
+    std::string libList;
+    for (size_t i = 1 + random.next(4); i > 0; --i)
+        libList += (libList.empty() ? "" : ",") + std::string(random.pick(libs));
+
+    static const char* queries[][2] =
+    {
+        { "--cflags", NULL },
+        { "--libs", NULL },
+        { "--libs", "" },
+        { "--rcflags", NULL },
+        { "--basename", NULL },
+    };
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i)
+    {
+        std::vector<std::string> query(1, queries[i][0]);
+        if (queries[i][1])
+            query.push_back(libList);
+        c.queries.push_back(query);
+    }
+
+    /// --easymode adds flags of its own, and --define-variable overrides a build.cfg key
+    /// or a setup.h feature before the flags are made
+    std::string defined = random.next(2) ? random.pick(bcfgBools) : random.pick(features);
+    static const char* options[] = { "--easymode", "--easymode=no", NULL };
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); ++i)
+    {
+        std::vector<std::string> query;
+        query.push_back(options[i] ? options[i] : "--define-variable=" + defined + "=" + random.pick(bools));
+        query.push_back("--cflags");
+        query.push_back("--libs");
+        query.push_back(libList);
+        c.queries.push_back(query);
+    }
+    return c;
+}
+
+/// Contents of a file, empty if it can't be read
+std::string readOutput(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return "";
+    TextView text = file.text();
+    return std::string(text.begin, text.end);
+}
+
+/// Output without its last line break, for the reports
+std::string trimLines(const std::string& output)
+{
+    size_t end = output.find_last_not_of("\r\n");
+    return end == std::string::npos ? "" : output.substr(0, end + 1);
+}
+
+/// Differential check of the current wx-config against a frozen reference build: both
+/// resolve every query of the corpus, and any byte of difference in their output, or
+/// in their exit code, is a failure. The prefixes of the failing cases are kept
+int benchCompare(const BenchOptions& opts, const std::string& reference, size_t cases, unsigned long seed)
+{
+    printf("reference: %s\ncorpus: %lu cases, seed %lu\n", reference.c_str(), (unsigned long)cases, seed);
+
+    char name[64];
+    sprintf(name, "wx-config-compare-%lu", currentPid());
+    std::string referenceFile = opts.dir + PATH_SEP + name + "-reference.txt";
+    std::string currentFile = opts.dir + PATH_SEP + name + "-current.txt";
+
+    Random random(seed);
+    unsigned long invocations = 0, failures = 0;
+    for (size_t index = 0; index < cases; ++index)
+    {
+        CorpusCase corpusCase = generateCase(index, random);
+        SyntheticPrefix prefix(prefixDir(opts), 0, 0, 0);
+        prefix.addConfig(corpusCase.cfg, corpusCase.buildCfg, corpusCase.setupH);
+
+        bool failed = false;
+        for (size_t q = 0; q < corpusCase.queries.size(); ++q)
+        {
+            std::vector<std::string> args;
+            args.push_back("--prefix=" + prefix.root());
+            args.push_back("--wxcfg=" + corpusCase.cfg);
+            args.insert(args.end(), corpusCase.queries[q].begin(), corpusCase.queries[q].end());
+
+            ChildProcess referenceRun, currentRun;
+            if (!referenceRun.start(reference, args, "", referenceFile) ||
+                !currentRun.start(opts.exe, args, "", currentFile))
+            {
+                std::cout << g_tokError << "Unable to run '" << reference << "' and '" << opts.exe << "'." << std::endl;
+                exit(1);
+            }
+            int referenceCode = referenceRun.wait();
+            int currentCode = currentRun.wait();
+            std::string referenceOutput = readOutput(referenceFile);
+            std::string currentOutput = readOutput(currentFile);
+            ++invocations;
+
+            if (referenceCode == currentCode && referenceOutput == currentOutput)
+                continue;
+
+            ++failures;
+            failed = true;
+            printf("\n  case %lu, %s:", (unsigned long)index, corpusCase.cfg.c_str());
+            for (size_t i = 2; i < args.size(); ++i)
+                printf(" %s", args[i].c_str());
+            printf("\n    reference (exit %d): %s", referenceCode, trimLines(referenceOutput).c_str());
+            printf("\n    current   (exit %d): %s", currentCode, trimLines(currentOutput).c_str());
+        }
+
+        if (failed)
+        {
+            prefix.keep();
+            printf("\n    prefix kept in %s\n", prefix.root().c_str());
+        }
+    }
+    remove(referenceFile.c_str());
+    remove(currentFile.c_str());
+
+    printf("\n%lu invocations compared, %lu differences\n", invocations, failures);
+    return failures ? 1 : 0;
+}
+
+// -------------------------------------------------------------------------------------------------
+
+void usage()
+{
+    std::cerr << "Usage: wx-config-bench startup|burst|parsers|budgets|autodetect|compare|threads [options]\n";
+    std::cerr << "  startup                     Latency of typical invocations, cold and warm.\n";
+    std::cerr << "  burst                       Rounds of concurrent invocations, as in make -jN.\n";
+    std::cerr << "  parsers                     Throughput of the build.cfg, setup.h and command\n";
+    std::cerr << "                              line parsers, on inputs in memory.\n";
+    std::cerr << "  budgets                     Checks the allocations of the resolution path against\n";
+    std::cerr << "                              the recorded budgets, fails when over budget.\n";
+    std::cerr << "  autodetect                  Scaling of the autodetection with the configurations\n";
+    std::cerr << "                              and the options left to it, cold and warm.\n";
+    std::cerr << "  compare                     Compares the output of wx-config with a reference\n";
+    std::cerr << "                              build over a generated corpus, fails on any difference.\n";
+    std::cerr << "  threads                     Throughput of in-process resolutions on 1 to N threads,\n";
+    std::cerr << "                              with and without a shared cache of the parsed files.\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --exe=FILE                  wx-config executable to benchmark.\n";
+    std::cerr << "  --dir=DIR                   Where the synthetic prefixes are generated.\n";
+    std::cerr << "  --runs=N                    Warm runs, or burst rounds, of each scenario (default 50).\n";
+    std::cerr << "  --cold-runs=N               Cold runs of each scenario (default 5).\n";
+    std::cerr << "  --configs=N[,N...]          Configurations of the prefixes (default 1,10,80).\n";
+    std::cerr << "  --size=realistic|extreme|all  Size of the setup.h files (default all).\n";
+    std::cerr << "  --jobs=N[,N...]             Concurrent invocations of a burst (default 1, 1x, 2x\n";
+    std::cerr << "                              and 4x the cores).\n";
+    std::cerr << "  --autodetect                Bursts without --wxcfg.\n";
+    std::cerr << "  --budgets=FILE              Budgets file (default wx-config-bench.budgets).\n";
+    std::cerr << "  --record                    Records the current allocations, plus 10%, as budgets.\n";
+    std::cerr << "  --reference=FILE            Reference wx-config executable, for compare.\n";
+    std::cerr << "  --cases=N                   Configurations of the compare corpus (default 500).\n";
+    std::cerr << "  --seed=N                    Seed of the compare corpus (default 1).\n";
+    std::cerr << "  --threads=N[,N...]          Threads of the threads mode (default 1, 2, 4... up to\n";
+    std::cerr << "                              the cores).\n";
+}
+
+/// Parses a comma separated list of numbers
+std::vector<size_t> parseCounts(const std::string& list)
+{
+    std::vector<size_t> counts;
+    size_t pos = 0;
+    while (pos <= list.size())
+    {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos)
+            comma = list.size();
+        counts.push_back(strtoul(list.substr(pos, comma - pos).c_str(), NULL, 10));
+        pos = comma + 1;
+    }
+    return counts;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc < 2 ? "" : argv[1];
+    if (mode != "startup" && mode != "burst" && mode != "parsers" && mode != "budgets" &&
+        mode != "autodetect" && mode != "compare" && mode != "threads")
+    {
+        usage();
+        return 1;
+    }
+
+    BenchArgs cl(argc, argv);
+
+    BenchOptions opts;
+#ifdef _WIN32
+    opts.exe = cl.keyExists("--exe") ? cl["--exe"] : "wx-config.exe";
+    opts.dir = cl.keyExists("--dir") ? cl["--dir"] : (getenv("TEMP") ? getenv("TEMP") : ".");
+#else
+    opts.exe = cl.keyExists("--exe") ? cl["--exe"] : "./wx-config";
+    opts.dir = cl.keyExists("--dir") ? cl["--dir"] : (getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+#endif
+    opts.runs = cl.keyExists("--runs") ? strtoul(cl["--runs"].c_str(), NULL, 10) : 50;
+    opts.coldRuns = cl.keyExists("--cold-runs") ? strtoul(cl["--cold-runs"].c_str(), NULL, 10) : 5;
+    opts.configs = parseCounts(cl.keyExists("--configs") ? cl["--configs"] : "1,10,80");
+    std::string size = cl.keyExists("--size") ? cl["--size"] : "all";
+    opts.realistic = size == "realistic" || size == "all";
+    opts.extreme = size == "extreme" || size == "all";
+    opts.autodetect = cl.keyExists("--autodetect");
+    if (cl.keyExists("--jobs"))
+        opts.jobs = parseCounts(cl["--jobs"]);
+    else
+    {
+        if (coreCount() > 1)
+            opts.jobs.push_back(1);
+        opts.jobs.push_back(coreCount());
+        opts.jobs.push_back(coreCount() * 2);
+        opts.jobs.push_back(coreCount() * 4);
+    }
+    if (cl.keyExists("--threads"))
+        opts.threads = parseCounts(cl["--threads"]);
+    else
+    {
+        for (size_t threads = 1; threads < coreCount(); threads *= 2)
+            opts.threads.push_back(threads);
+        opts.threads.push_back(coreCount());
+    }
+
+    printf("wx-config-bench: %s\n", opts.exe.c_str());
+    if (mode == "startup")
+        benchStartup(opts);
+    else if (mode == "burst")
+        benchBurst(opts);
+    else if (mode == "parsers")
+        benchParsers(opts);
+    else if (mode == "autodetect")
+        benchAutodetect(opts);
+    else if (mode == "threads")
+        return benchThreads(opts);
+    else if (mode == "compare")
+    {
+        if (!cl.keyExists("--reference"))
+        {
+            std::cout << g_tokError << "The compare mode needs a reference executable." << std::endl;
+            std::cerr << "Use --reference=FILE, for instance a wx-config built from the last release." << std::endl;
+            return 1;
+        }
+        return benchCompare(opts, cl["--reference"], cl.keyExists("--cases") ? strtoul(cl["--cases"].c_str(), NULL, 10) : 500,
+                            cl.keyExists("--seed") ? strtoul(cl["--seed"].c_str(), NULL, 10) : 1);
+    }
+    else
+        return benchBudgets(opts, cl.keyExists("--budgets") ? cl["--budgets"] : "wx-config-bench.budgets",
+                            cl.keyExists("--record"));
+
+    return 0;
+}
@@ -14,13 +14,52 @@
 #include <iostream>
 #include <string>
 #include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <exception>
 
 #include <map>
-#include <fstream>
 #include <algorithm>
 #include <vector>
 
-#include <windows.h>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <sys/stat.h>
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <utime.h>
+    #include <climits>
+    #include <pthread.h>
+#endif
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <sys/vfs.h>
+    #include <sys/ioctl.h>
+    #include <linux/fs.h>
+    #include <poll.h>
+#endif
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+#include "wx-config-win.h"
+
+/// Native path separator, as a literal that can be concatenated to other literals
+#ifdef _WIN32
+    #define PATH_SEP "\\"
+#else
+    #define PATH_SEP "/"
+#endif
+
+/// Prefix of the MinGW cross toolchain programs, when running on a POSIX host
+#ifndef WXCONFIG_MINGW_PREFIX
+    #define WXCONFIG_MINGW_PREFIX "x86_64-w64-mingw32-"
+#endif
 
 // -------------------------------------------------------------------------------------------------
 
@@ -45,497 +84,2609 @@ std::string getSvnDate()
 static const std::string g_tokError = "wx-config Error: ";
 static const std::string g_tokWarning = "wx-config Warning: ";
 
+/// Returned by reference for the flags left out; at namespace scope, as the function-local
+/// statics of C++98 compilers are not initialized safely by concurrent resolutions
+static const std::string g_empty;
+
+static const std::string g_hintWxcfg = "Please use the --wxcfg flag (as in wx-config --wxcfg=gcc_dll\\mswud)\n"
+                                       "or set the environment variable WXCFG (as in WXCFG=gcc_dll\\mswud)\n"
+                                       "to specify which configuration exactly you want to use.\n";
+
 // -------------------------------------------------------------------------------------------------
 
-/// Program options
-class Options
+/// A flag as the Compiler::add* helpers make it, [switch][ ][prefix]value[.extension],
+/// without building it: a FlagBuilder appends its parts in place. It refers to the strings
+/// it was made of, so it must be used in the expression making it. It converts to the
+/// text of the flag for the fragments kept in the options
+struct Flag
 {
-public:
-    std::string& operator[](const std::string& key)
+    Flag() : sw(NULL), prefix(NULL), value(NULL), extension(NULL), separate(false) {}
+
+    Flag(const std::string& v) : sw(NULL), prefix(NULL), value(&v), extension(NULL), separate(false) {}
+
+    Flag(const std::string& s, const std::string& v, bool sep)
+        : sw(&s), prefix(NULL), value(&v), extension(NULL), separate(sep) {}
+
+    bool empty() const
     {
-        return m_vars[key];
+        return value == NULL || value->empty();
     }
 
-    bool keyExists(const std::string& key) const
+    size_t length() const
     {
-        return m_vars.count(key) != 0;
+        if (empty())
+            return 0;
+        return (sw ? sw->length() + separate : 0) + (prefix ? prefix->length() : 0) + value->length() +
+               (extension ? extension->length() + 1 : 0) + 1;
     }
-    
-    const std::string& keyValue(const std::string& key) const
+
+    /// Appends the text of the flag, followed by a space
+    void appendTo(std::string& target) const
     {
-        return m_vars.find(key)->second;
+        if (empty())
+            return;
+        if (sw)
+        {
+            target += *sw;
+            if (separate)
+                target += ' ';
+        }
+        if (prefix)
+            target += *prefix;
+        target += *value;
+        if (extension)
+        {
+            target += '.';
+            target += *extension;
+        }
+        target += ' ';
     }
 
-    std::map<std::string,std::string>& getVars()
+    operator std::string() const
     {
-        return m_vars;
+        std::string result;
+        result.reserve(length());
+        appendTo(result);
+        return result;
     }
-protected:
-    std::map<std::string,std::string> m_vars;
-};
 
-// -------------------------------------------------------------------------------------------------
+    const std::string* sw;          ///< as -I, or NULL
+    const std::string* prefix;      ///< of the value, as the lib of libwxbase28.a, or NULL
+    const std::string* value;       ///< NULL for no flag
+    const std::string* extension;   ///< appended after a '.', or NULL
+    bool separate;                  ///< a space between the switch and the value
+};
 
-/// File build.cfg/config.* options
-class BuildFileOptions : public Options
+/// Appends flags in place into a string, instead of chaining operator+ temporaries.
+/// Given a list of arguments, it also records each flag there as the argument of a tool,
+/// as exec mode passes them: a Flag is one argument as it is, spaces in its path
+/// included (two for a switch apart from its value, as windres --include-dir DIR or
+/// Watcom's libp DIR). The text appended between two
+/// Flags (the fragments kept in the options, the flags of build.cfg, whose spaces are
+/// dropped when parsed) has no path, and is split at its spaces
+class FlagBuilder
 {
 public:
-    BuildFileOptions(const std::string& filepath)
+    FlagBuilder(std::string& target, size_t capacity = 512) : m_target(target), m_args(NULL), m_text(0)
     {
-        parse(filepath);
+        m_target.clear();
+        m_target.reserve(capacity);
     }
 
-    bool parse(const std::string& filepath)
+    FlagBuilder(std::string& target, std::vector<std::string>& args, size_t capacity = 512)
+        : m_target(target), m_args(&args), m_text(0)
     {
-        std::string line;
-        std::ifstream file(filepath.c_str());
-        if (file.is_open())
-        {
-            while (!file.eof() )
-            {
-                std::getline(file, line);
-
-                // it's a comment line
-                if (line.find_first_of('#') != std::string::npos)
-                    continue;
+        m_target.clear();
+        m_target.reserve(capacity);
+        m_args->clear();
+    }
 
-                // strip spaces
-                line.erase( std::remove(line.begin(), line.end(), ' '), line.end() );
+    ~FlagBuilder()
+    {
+        splitText();
+    }
 
-                split(line);
-            }
-            file.close();
+    FlagBuilder& operator<<(const Flag& flag)
+    {
+        if (!m_args || flag.empty())
+        {
+            flag.appendTo(m_target);
+            return *this;
+        }
 
-            if (!m_vars.empty())
-                return true;
+        splitText();
+        size_t begin = m_target.length();
+        flag.appendTo(m_target);
+        if (flag.sw && (flag.separate || (!flag.sw->empty() && *flag.sw->rbegin() == ' ')))
+        {
+            size_t length = flag.sw->length() - (flag.separate ? 0 : 1);
+            m_args->push_back(flag.sw->substr(0, length));
+            begin += length + 1;
         }
-        else
-            std::cout << g_tokError << "Unable to open file '" << filepath.c_str() << "'." << std::endl;
+        m_args->push_back(m_target.substr(begin, m_target.length() - 1 - begin));
+        m_text = m_target.length();
+        return *this;
+    }
 
-        return false;
+    FlagBuilder& operator<<(const std::string& str)
+    {
+        m_target.append(str);
+        return *this;
+    }
+
+    FlagBuilder& operator<<(const char* str)
+    {
+        m_target.append(str);
+        return *this;
     }
 
 protected:
-    void split(const std::string& line)
+    /// Records the arguments of the text appended since the last Flag
+    void splitText()
     {
-        size_t sep = line.find('=');
-        if (sep != std::string::npos)
+        if (!m_args)
+            return;
+
+        const char* blanks = " \t\r\n";
+        size_t begin = m_target.find_first_not_of(blanks, m_text);
+        while (begin != std::string::npos)
         {
-            std::string key = line.substr(0, sep);
-            std::string val = line.substr(sep+1, line.size()-sep-1);
-            m_vars[key] = val;
+            size_t end = m_target.find_first_of(blanks, begin);
+            m_args->push_back(m_target.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+            begin = m_target.find_first_not_of(blanks, end);
         }
+        m_text = m_target.length();
     }
+
+    std::string& m_target;
+    std::vector<std::string>* m_args;   ///< NULL if not recorded
+    size_t m_text;                      ///< where the text not split yet begins
 };
 
 // -------------------------------------------------------------------------------------------------
 
-/// File setup.h options
-class SetupHOptions
+/// Time spent by each phase of a run, reported to stderr by --trace-timing
+class TimingTrace
 {
 public:
-    bool& operator[](const std::string& key)
+    TimingTrace() : m_enabled(false), m_count(0)
     {
-        return m_vars[key];
+        m_start = m_last = now();
     }
 
-    bool keyExists(const std::string& key) const
-    {
-        return m_vars.count(key) != 0;
-    }
-    
-    bool keyValue(const std::string& key) const
-    {
-        return m_vars.find(key)->second;
-    }
-    
-    typedef std::map<std::string,bool> StringBoolMap;
-    
-    StringBoolMap& getVars()
+    /// Phases are only accounted once enabled, so that the resolutions of a program
+    /// linking the resolver do not all write to the table
+    void enable()
     {
-        return m_vars;
+        m_enabled = true;
     }
-protected:
-    StringBoolMap m_vars;
 
-    
-public:
-    SetupHOptions(const std::string& filepath)
+    /// Closes the current phase: the time elapsed since the previous mark is accounted to it
+    void mark(const char* phase)
     {
-        parse(filepath);
+        if (!m_enabled)
+            return;
+
+        double t = now();
+        Phase* p = find(phase);
+        if (p)
+            p->elapsed += t - m_last;
+        m_last = t;
     }
 
-    bool parse(const std::string& filepath)
+    void report(FILE* stream) const
     {
-        std::string line;
-        std::ifstream file(filepath.c_str());
-        if (file.is_open())
-        {
-            while (!file.eof())
-            {
-                std::getline(file, line);
-                
-                // does the splitting/parsing
-                split(line);
-            }
-            file.close();
-
-            if (!m_vars.empty())
-                return true;
-        }
-        else
-            std::cout << g_tokError << "Unable to open file '" << filepath.c_str() << "'." << std::endl;
-
-        return false;
+        fprintf(stream, "wx-config timing (ms):\n");
+        for (int i = 0; i < m_count; ++i)
+            fprintf(stream, "  %-24s %10.3f\n", m_phases[i].name, m_phases[i].elapsed / 1000.0);
+        fprintf(stream, "  %-24s %10.3f\n", "total", (m_last - m_start) / 1000.0);
     }
-    
-    void printDebug()
+
+    /// Microseconds from an arbitrary origin, monotonic and high resolution
+    static double now()
     {
-        std::cout << "DEBUG: setup.h contents BEGIN -------------------------------------------------" << std::endl;
-        for (StringBoolMap::iterator it = m_vars.begin(); it != m_vars.end(); ++it)
-            std::cout << it->first << "=" << it->second << std::endl;
-        std::cout << "DEBUG: setup.h contents END ---------------------------------------------------" << std::endl;
+#ifdef _WIN32
+        LARGE_INTEGER count, frequency;
+        QueryPerformanceCounter(&count);
+        QueryPerformanceFrequency(&frequency);
+        return count.QuadPart * 1000000.0 / frequency.QuadPart;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+#endif
     }
 
 protected:
-    void split(std::string& line)
+    struct Phase
     {
-        // it's a comment line
-        if (line.find_first_of('/') != std::string::npos)
-            return; // skips the line
-            
-        // strip spaces and tabs
-        line.erase( std::remove(line.begin(), line.end(), ' '), line.end() );
-        line.erase( std::remove(line.begin(), line.end(), '\t'), line.end() );
-        
-        std::string tokDefine("#define");
-        size_t posDefine = line.find_first_of(tokDefine);
-                        
-        // it's a #define line
-        if (posDefine != std::string::npos)
-        {
-            std::string key;
-            bool val;
+        const char* name;
+        double elapsed;
+    };
 
-            // resolves val, checking if last char is 0 or 1
-            char lastChar = line.at(line.length()-1);       // TODO: I don't like this line :P
-            if (lastChar == '0')
-                val = false;
-            else if (lastChar == '1')
-                val = true;
-            else
-                return; // skips the line
-            
-            // resolves key
-            size_t startPos = posDefine + tokDefine.length();
-            key = line.substr(startPos, line.length() - startPos - 1);
+    /// Phases are kept in a fixed table, so that tracing does not allocate
+    Phase* find(const char* phase)
+    {
+        for (int i = 0; i < m_count; ++i)
+            if (strcmp(m_phases[i].name, phase) == 0)
+                return &m_phases[i];
 
-            // finally saves the parsed data!
-            m_vars[key] = val;
-        }        
+        if (m_count == MaxPhases)
+            return NULL;
+
+        m_phases[m_count].name = phase;
+        m_phases[m_count].elapsed = 0;
+        return &m_phases[m_count++];
     }
+
+    enum { MaxPhases = 16 };
+    bool m_enabled;
+    Phase m_phases[MaxPhases];
+    int m_count;
+    double m_start;
+    double m_last;
 };
 
+static TimingTrace g_timing;
+
+/// Prints the timing report, also when the run ends through exit()
+void reportTiming()
+{
+    g_timing.report(stderr);
+}
 
 // -------------------------------------------------------------------------------------------------
 
-/// Command line options
-class CmdLineOptions : public Options
+/// Nested spans of a run, written by --trace-out as Chrome trace-event JSON.
+/// Timestamps are absolute (microseconds since the epoch) and tagged with the pid,
+/// so that the traces of concurrent invocations line up on a single timeline
+class TraceRecorder
 {
 public:
-    CmdLineOptions(int argc, char* argv[])
-    {
-        parse(argc, argv);
-    }
-
-    bool validArgs()
-    {
-        bool valid = keyExists("--compiler") ||
-                     keyExists("--easymode") ||
-                     keyExists("--variable") ||
-                     keyExists("--define-variable") ||
-                     keyExists("--prefix") ||
-                     keyExists("--wxcfg") ||
-                     keyExists("--libs") ||
-                     keyExists("--cflags") ||
-                     keyExists("--cxxflags") ||
-                     keyExists("--cppflags") ||
-                     keyExists("--rcflags") ||
-                     keyExists("--list") ||
-                     keyExists("--debug") ||
-                     keyExists("--unicode") ||
-                     keyExists("--static") ||
-                     keyExists("--universal") ||
-                     keyExists("--release") ||
-                     keyExists("--version") ||
-                     keyExists("--basename") ||
-                     keyExists("--cc") ||
-                     keyExists("--cxx") ||
-                     keyExists("--ld") ||
-                     keyExists("-v");
-
-        // TODO: not all flags are being validated
-        if(!valid)
-        {
-            if (m_vars.size() > 1 && !keyExists("--help"))
-                std::cout << g_tokError << "Unrecognised option: '" << m_vars.begin()->first << "'\n" << std::endl;
-
-            std::cerr << "Usage: wx-config [options]\n";
-            std::cerr << "Options:\n";
-            std::cerr << "  --prefix[=DIR]              Path of the wxWidgets installation (ie. C:\\wxWidgets2.6.3)\n";
-            std::cerr << "  --wxcfg[=DIR]               Relative path of the build.cfg file (ie. gcc_dll\\mswud)\n";
-//          std::cerr << "  --list                      Lists all the library configurations. [NOT IMPLEMENTED]\n";
-            std::cerr << "  --cflags                    Outputs all pre-processor and compiler flags.\n";
-            std::cerr << "  --cxxflags                  Same as --cflags but for C++.\n";
-            std::cerr << "  --rcflags                   Outputs all resource compiler flags. [UNTESTED]\n";
-            std::cerr << "  --libs                      Outputs all linker flags.\n";
-            std::cerr << std::endl;
-            std::cerr << "  --debug[=yes|no]            Uses a debug configuration if found.\n";
-            std::cerr << "  --unicode[=yes|no]          Uses an unicode configuration if found.\n";
-            std::cerr << "  --static[=yes|no]           Uses a static configuration if found.\n";
-            std::cerr << "  --universal[=yes|no]        Uses an universal configuration if found.\n";
-//          std::cerr << "  --easymode[=yes|no]         Outputs warnings, and optimize flags.\n";
-            std::cerr << "  --compiler[=gcc,dmc,vc]     Selects the compiler.\n";
-//          std::cerr << "  --variable=NAME             Returns the value of a defined variable.\n";
-//          std::cerr << "  --define-variable=NAME=VAL  Sets a global value for a variable.\n";
-            std::cerr << "  --release                   Outputs the wxWidgets release number.\n";
-            std::cerr << "  --version                   Outputs the wxWidgets version.\n";
-            std::cerr << "  --basename                  Outputs the base name of the wxWidgets libraries.\n";
-            std::cerr << "  --cc                        Outputs the name of the C compiler.\n";
-            std::cerr << "  --cxx                       Outputs the name of the C++ compiler.\n";
-            std::cerr << "  --ld                        Outputs the linker command.\n";
-            std::cerr << "  -v                          Outputs the revision of wx-config.\n";
-
-
-            std::cerr << std::endl;
-            std::cerr << "  Note that using --prefix is not needed if you have defined the \n";
-            std::cerr << "  environmental variable WXWIN.\n";
-            std::cerr << std::endl;
-            std::cerr << "  Also note that using --wxcfg is not needed if you have defined the \n";
-            std::cerr << "  environmental variable WXCFG.\n";
-            std::cerr << std::endl;
-        }
-
-        return valid;
+    TraceRecorder() : m_enabled(false)
+    {
+        m_origin = TimingTrace::now();
+#ifdef _WIN32
+        FILETIME ft;
+        GetSystemTimeAsFileTime(&ft);
+        ULARGE_INTEGER t;
+        t.LowPart = ft.dwLowDateTime;
+        t.HighPart = ft.dwHighDateTime;
+        m_epoch = (t.QuadPart - 116444736000000000.0) / 10.0;
+        m_pid = GetCurrentProcessId();
+#else
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        m_epoch = ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+        m_pid = getpid();
+#endif
     }
 
-    bool parse(int argc, char* argv[])
+    /// Enables the recording; when path is a directory, the trace goes to 'DIR/wx-config-<pid>.json'
+    void enable(const std::string& path)
     {
-        for(int i=0; i<argc; ++i)
+        m_enabled = true;
+        m_path = path;
+
+        struct stat st;
+        if (!m_path.empty() && stat(m_path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR)
         {
-            std::string line;
-            line = argv[i];
-            split(line);
+            char name[64];
+            sprintf(name, "wx-config-%lu.json", m_pid);
+            if (m_path[m_path.length() - 1] != '/' && m_path[m_path.length() - 1] != '\\')
+                m_path += PATH_SEP;
+            m_path += name;
         }
-        parseLibs(argv[argc-1]);
-
-        return true;
     }
 
-    std::vector<std::string> getLibs() const
+    bool enabled() const
     {
-        return m_libs;
+        return m_enabled;
     }
 
-protected:
-
-    void split(const std::string& line)
+    /// Opens a span, argName/argValue describe the file or configuration involved
+    void begin(const char* name, const char* argName = NULL, const std::string& argValue = "", double start = -1)
     {
-        size_t sep = line.find("=");
-        if (sep != std::string::npos)
-        {
-            std::string key = line.substr(0, sep);
-            std::string val = line.substr(sep+1, line.size()-sep-1);
-            m_vars[key] = val;
-        }
-        else
-            m_vars[line] = "";
+        if (!m_enabled)
+            return;
+
+        Event event;
+        event.phase = 'B';
+        event.name = name;
+        event.argName = argName;
+        event.argValue = argValue;
+        event.timestamp = start < 0 ? TimingTrace::now() : start;
+        m_events.push_back(event);
+        m_open.push_back(name);
     }
 
-    bool libExists(const std::string& lib)
+    void end()
     {
-        return std::find(m_libs.begin(), m_libs.end(), lib) != m_libs.end();
+        if (!m_enabled || m_open.empty())
+            return;
+
+        Event event;
+        event.phase = 'E';
+        event.name = m_open.back();
+        event.argName = NULL;
+        event.timestamp = TimingTrace::now();
+        m_events.push_back(event);
+        m_open.pop_back();
     }
 
-    void addLib(const std::string& lib)
+    /// Closes the spans left open (by an exit()) and writes the trace
+    void write()
     {
-        // adds the lib if its not present already
-        if (!libExists(lib))
-            m_libs.push_back(lib);
-    }
+        while (!m_open.empty())
+            end();
 
-    void parseLibs(const std::string libs)
-    {
-        std::string param = libs;
+        FILE* file = fopen(m_path.c_str(), "w");
+        if (!file)
+        {
+            std::cerr << g_tokWarning << "Unable to write the trace to '" << m_path << "'." << std::endl;
+            return;
+        }
 
-        // if the last parameter doesn't haves a -- switch
-        if (param.find("--") == std::string::npos)
+        fprintf(file, "{\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"wx-config\"}}",
+                m_pid, m_pid);
+        for (std::vector<Event>::const_iterator it = m_events.begin(); it != m_events.end(); ++it)
         {
-            // saves in the vector, comma separated text like "text1,text2,text3,text4"
-            while(true)
-            {
-                size_t comma = param.find(",");
-                if (comma != std::string::npos)
-                {
-                    m_libs.push_back(param.substr(0, comma));
-                    param = param.substr(comma+1, param.size()-comma-1);
-                }
-                else
-                {
-                    m_libs.push_back(param);
-                    break;
-                }
-            }
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"wx-config\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu",
+                    it->name, it->phase, m_epoch + (it->timestamp - m_origin), m_pid, m_pid);
+            if (it->argName)
+                fprintf(file, ",\"args\":{\"%s\":\"%s\"}", it->argName, escape(it->argValue).c_str());
+            fprintf(file, "}");
         }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        fclose(file);
+    }
 
-        // assuming magic keyword 'std' as a lib parameter for non-monolithic
-        // magic keyword std: links with xrc,qa,html,adv,core,base_xml,base_net,base
-        if (m_libs.empty() || libExists("std"))
+protected:
+    /// A JSON string: the control characters, which a path or an argument may have, are
+    /// escaped as \u00XX
+    static std::string escape(const std::string& str)
+    {
+        std::string escaped;
+        for (std::string::const_iterator c = str.begin(); c != str.end(); ++c)
         {
-            addLib("xrc");
-            addLib("qa");
-            addLib("html");
-            addLib("adv");
-            addLib("core");
-            addLib("xml");
-            addLib("net");
-            addLib("base");
+            if (static_cast<unsigned char>(*c) < 0x20)
+            {
+                char code[8];
+                sprintf(code, "\\u%04x", static_cast<unsigned char>(*c));
+                escaped += code;
+                continue;
+            }
+            if (*c == '\\' || *c == '"')
+                escaped += '\\';
+            escaped += *c;
         }
+        return escaped;
     }
 
-    std::vector<std::string> m_libs;
+    struct Event
+    {
+        char phase;
+        const char* name;
+        const char* argName;
+        std::string argValue;
+        double timestamp;
+    };
+
+    bool m_enabled;
+    std::string m_path;
+    unsigned long m_pid;
+    double m_origin;
+    double m_epoch;
+    std::vector<Event> m_events;
+    std::vector<const char*> m_open;
 };
 
-// -------------------------------------------------------------------------------------------------
+static TraceRecorder g_trace;
 
-/// Struct to keep programs
-struct CompilerPrograms
+/// Span closed when leaving the scope
+class TraceSpan
 {
-    std::string cc; // C compiler
-    std::string cxx; // C++ compiler
-    std::string ld; // dynamic libs linker
-    std::string lib; // static libs linker
-    std::string windres; // resource compiler
+public:
+    TraceSpan(const char* name, const char* argName = NULL, const std::string& argValue = "")
+    {
+        g_trace.begin(name, argName, argValue);
+    }
+
+    ~TraceSpan()
+    {
+        g_trace.end();
+    }
 };
 
-/// Struct to keep switches
-struct CompilerSwitches
+/// Writes the trace, also when the run ends through exit()
+void writeTrace()
 {
-    std::string includeDirs;   // -I
-    std::string resIncludeDirs;   // --include-dir
-    std::string libDirs;       // -L
-    std::string linkLibs;      // -l
-    std::string libPrefix; // lib
-    std::string libExtension; // a
-    std::string defines;       // -D
-    std::string resDefines;    // --define
-    std::string genericSwitch; // -
-    std::string objectExtension; // o
-    bool forceLinkerUseQuotes; // use quotes for filenames in linker command line (needed or not)?
-    bool forceCompilerUseQuotes; // use quotes for filenames in compiler command line (needed or not)?
-    bool linkerNeedsLibPrefix; // when adding a link library, linker needs prefix?
-    bool linkerNeedsLibExtension; // when adding a link library, linker needs extension?
-    bool supportsPCH; // supports precompiled headers?
-    std::string PCHExtension; // precompiled headers extension
+    g_trace.write();
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Counters of the work done by a run, reported to stderr by --stats
+struct RunStats
+{
+    bool enabled;
+    bool concurrent;                ///< several threads allocate: the heap is not followed
+    unsigned long allocations;
+    unsigned long allocatedBytes;
+    unsigned long heapBytes;        ///< currently allocated
+    unsigned long heapPeak;
+    unsigned long optionLookups;
+    unsigned long optionInserts;
+    unsigned long buildCfgLines;
+    unsigned long setupHLines;
+    unsigned long candidates;
+    unsigned long distinctCandidates;
+    unsigned long stagedFiles;
+    unsigned long stagedCurrent;    ///< already up to date
 };
 
-static bool g_sEasyMode = false;
+/// Plain data, so zero-initialized before any allocation can happen
+static RunStats g_stats;
+
+/// The replacements below must not be inlined into their callers, where GCC would pair
+/// the malloc() of one with the free() of the other and warn about a mismatch
+#ifdef __GNUC__
+    #define WXCONFIG_NOINLINE __attribute__((noinline))
+#else
+    #define WXCONFIG_NOINLINE
+#endif
+
+/// Dynamic exception specifications are an error since C++17
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+    #define WXCONFIG_THROW_BAD_ALLOC
+    #define WXCONFIG_NOTHROW noexcept
+#else
+    #define WXCONFIG_THROW_BAD_ALLOC throw(std::bad_alloc)
+    #define WXCONFIG_NOTHROW throw()
+#endif
+
+/// The allocations are counted by replacing the global operator new, only in the builds
+/// that report them (WXCONFIG_COUNT_ALLOCATIONS, which the benchmarks define): the header
+/// of each block would otherwise tax every run. A program linking the resolver
+/// (WXCONFIG_LIBRARY) keeps its operator new in any case
+#if defined(WXCONFIG_COUNT_ALLOCATIONS) && !defined(WXCONFIG_LIBRARY)
+
+/// Each block starts with its size, so that the heap in use can be followed; the header
+/// is 16 bytes to keep the alignment of malloc()
+static const size_t g_allocHeader = 16;
 
-void checkEasyMode(CmdLineOptions& cl)
+WXCONFIG_NOINLINE void* operator new(size_t size) WXCONFIG_THROW_BAD_ALLOC
 {
-    if (cl.keyExists("--easymode"))
+    // the blocks allocated by concurrent threads are recorded with a size of 0, so that
+    // neither their allocation nor their release writes to the shared counters
+    size_t counted = g_stats.concurrent ? 0 : size;
+    if (counted)
     {
-        if (cl["--easymode"] == "no")
-            g_sEasyMode = false;
-        else if (cl["--easymode"] == "yes" || cl["--easymode"].empty())
-            g_sEasyMode = true;
+        ++g_stats.allocations;
+        g_stats.allocatedBytes += size;
+        g_stats.heapBytes += size;
+        if (g_stats.heapBytes > g_stats.heapPeak)
+            g_stats.heapPeak = g_stats.heapBytes;
     }
+
+    char* p = (char*)malloc(size + g_allocHeader);
+    if (!p)
+        throw std::bad_alloc();
+    *(size_t*)p = counted;
+    return p + g_allocHeader;
 }
 
-/// Compiler abstract base class
-class Compiler
+void* operator new[](size_t size) WXCONFIG_THROW_BAD_ALLOC
 {
-public:
-    Compiler(const std::string& name) : m_name(name) {}
-    // ~Compiler();
+    return operator new(size);
+}
 
-    std::string easyMode(const std::string& str)
-    {
-        if (g_sEasyMode)
-            return str;
-        else
-            return std::string();
-    }
+WXCONFIG_NOINLINE void operator delete(void* p) WXCONFIG_NOTHROW
+{
+    if (!p)
+        return;
 
-    std::string addFlag(const std::string& flag)
-    {
-        if (flag.empty())
-            return "";
-        return flag + " ";
-    }
+    char* block = (char*)p - g_allocHeader;
+    if (*(size_t*)block)
+        g_stats.heapBytes -= *(size_t*)block;
+    free(block);
+}
 
-    std::string addLib(const std::string& lib)
-    {
-        std::string result;
-        result = m_switches.linkLibs;
+WXCONFIG_NOINLINE void operator delete[](void* p) WXCONFIG_NOTHROW
+{
+    operator delete(p);
+}
 
-        if (m_switches.linkerNeedsLibPrefix)
-            result += m_switches.libPrefix;
+/// C++14 deletes with the size of the block when it is known, which the header has too
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) WXCONFIG_NOTHROW
+{
+    operator delete(p);
+}
 
-        result += lib;
+void operator delete[](void* p, size_t) WXCONFIG_NOTHROW
+{
+    operator delete(p);
+}
+#endif
 
-        if (m_switches.linkerNeedsLibExtension)
-            result += "." + m_switches.libExtension;
+#endif // WXCONFIG_COUNT_ALLOCATIONS
 
-        result += " ";
+// -------------------------------------------------------------------------------------------------
 
-        if (lib.empty())
-            return "";
-        return result;
-    }
+/// Reference counts of the inputs shared by concurrent resolutions
+#ifdef _WIN32
+    typedef LONG AtomicCount;
 
-    std::string addDefine(const std::string& define)
+    inline long atomicIncrement(volatile AtomicCount& count)
     {
-        if (define.empty())
-            return "";
-        return m_switches.defines + define + " ";
+        return InterlockedIncrement(&count);
     }
 
-    std::string addResDefine(const std::string& resDefine)
+    inline long atomicDecrement(volatile AtomicCount& count)
     {
-        if (resDefine.empty())
-            return "";
-        return m_switches.resDefines + " " + resDefine + " ";
+        return InterlockedDecrement(&count);
     }
+#else
+    typedef long AtomicCount;
 
-    std::string addIncludeDir(const std::string& includeDir)
+    inline long atomicIncrement(volatile AtomicCount& count)
     {
-        if (includeDir.empty())
-            return "";
-        return m_switches.includeDirs + includeDir + " ";
+        return __sync_add_and_fetch(&count, 1);
     }
 
-    std::string addLinkerDir(const std::string& libDir)
+    inline long atomicDecrement(volatile AtomicCount& count)
     {
-        if (libDir.empty())
-            return "";
-        return m_switches.libDirs + libDir + " ";
+        return __sync_sub_and_fetch(&count, 1);
     }
+#endif
 
-    std::string addResIncludeDir(const std::string& resIncludeDir)
-    {
-        if (resIncludeDir.empty())
-            return "";
-        return m_switches.resIncludeDirs + " " + resIncludeDir + " ";
-    }
-/*
-    std::string addResLinkerDir(const std::string& resLibDir)
+/// Loads a pointer published by atomicStore(): what was written before the store is
+/// visible through it. Without the GCC builtins (VC, DMC), x86 loads and stores already
+/// have these semantics and the compilers do not reorder volatile accesses
+template <class T>
+inline T* atomicLoad(T* const volatile& source)
+{
+#if defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(&source, __ATOMIC_ACQUIRE);
+#else
+    return source;
+#endif
+}
+
+template <class T>
+inline void atomicStore(T* volatile& target, T* value)
+{
+#if defined(__ATOMIC_RELEASE)
+    __atomic_store_n(&target, value, __ATOMIC_RELEASE);
+#else
+    target = value;
+#endif
+}
+
+/// Stores the pointer as atomicStore() does if target is still NULL, false if another
+/// thread stored one first
+template <class T>
+inline bool atomicPublish(T* volatile& target, T* value)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchangePointer((PVOID volatile*)&target, (PVOID)value, NULL) == NULL;
+#else
+    return __sync_bool_compare_and_swap(&target, (T*)NULL, value);
+#endif
+}
+
+/// Mutual exclusion of the writers of the shared inputs
+class Mutex
+{
+public:
+#ifdef _WIN32
+    Mutex() { InitializeCriticalSection(&m_mutex); }
+    ~Mutex() { DeleteCriticalSection(&m_mutex); }
+    void lock() { EnterCriticalSection(&m_mutex); }
+    void unlock() { LeaveCriticalSection(&m_mutex); }
+#else
+    Mutex() { pthread_mutex_init(&m_mutex, NULL); }
+    ~Mutex() { pthread_mutex_destroy(&m_mutex); }
+    void lock() { pthread_mutex_lock(&m_mutex); }
+    void unlock() { pthread_mutex_unlock(&m_mutex); }
+#endif
+
+protected:
+#ifdef _WIN32
+    CRITICAL_SECTION m_mutex;
+#else
+    pthread_mutex_t m_mutex;
+#endif
+
+private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+};
+
+/// Event signalled once, waited for by any number of threads
+class Completion
+{
+public:
+#ifdef _WIN32
+    Completion() { m_event = CreateEventA(NULL, TRUE, FALSE, NULL); }
+    ~Completion() { CloseHandle(m_event); }
+    void signal() { SetEvent(m_event); }
+    void wait() { WaitForSingleObject(m_event, INFINITE); }
+#else
+    Completion() : m_done(false)
+    {
+        pthread_mutex_init(&m_mutex, NULL);
+        pthread_cond_init(&m_cond, NULL);
+    }
+
+    ~Completion()
+    {
+        pthread_cond_destroy(&m_cond);
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void signal()
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_done = true;
+        pthread_cond_broadcast(&m_cond);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    void wait()
+    {
+        pthread_mutex_lock(&m_mutex);
+        while (!m_done)
+            pthread_cond_wait(&m_cond, &m_mutex);
+        pthread_mutex_unlock(&m_mutex);
+    }
+#endif
+
+protected:
+#ifdef _WIN32
+    HANDLE m_event;
+#else
+    bool m_done;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+#endif
+
+private:
+    Completion(const Completion&);
+    Completion& operator=(const Completion&);
+};
+
+/// Thread running a function until joined. It may fail to start, as when the limit of
+/// threads or processes is reached: the function is then never called
+class Thread
+{
+public:
+    Thread(void (*function)(void*), void* arg) : m_function(function), m_arg(arg)
+    {
+#ifdef _WIN32
+        m_handle = CreateThread(NULL, 0, run, this, 0, NULL);
+        m_started = m_handle != NULL;
+#else
+        m_started = pthread_create(&m_thread, NULL, run, this) == 0;
+#endif
+    }
+
+    bool started() const
+    {
+        return m_started;
+    }
+
+    void join()
+    {
+        if (!m_started)
+            return;
+#ifdef _WIN32
+        WaitForSingleObject(m_handle, INFINITE);
+        CloseHandle(m_handle);
+#else
+        pthread_join(m_thread, NULL);
+#endif
+    }
+
+protected:
+#ifdef _WIN32
+    static DWORD WINAPI run(LPVOID self)
+    {
+        ((Thread*)self)->m_function(((Thread*)self)->m_arg);
+        return 0;
+    }
+
+    HANDLE m_handle;
+#else
+    static void* run(void* self)
+    {
+        ((Thread*)self)->m_function(((Thread*)self)->m_arg);
+        return NULL;
+    }
+
+    pthread_t m_thread;
+#endif
+    bool m_started;
+    void (*m_function)(void*);
+    void* m_arg;
+};
+
+/// Mutex held for a scope
+class MutexLock
+{
+public:
+    MutexLock(Mutex& mutex) : m_mutex(mutex)
+    {
+        m_mutex.lock();
+    }
+
+    ~MutexLock()
+    {
+        m_mutex.unlock();
+    }
+
+protected:
+    Mutex& m_mutex;
+};
+
+/// Counted reference to a shared object, which is deleted with its last reference
+template <class T>
+class SharedRef
+{
+public:
+    SharedRef(T* p = NULL) : m_p(p)
+    {
+        if (m_p)
+            m_p->addRef();
+    }
+
+    SharedRef(const SharedRef& other) : m_p(other.m_p)
+    {
+        if (m_p)
+            m_p->addRef();
+    }
+
+    ~SharedRef()
+    {
+        if (m_p)
+            m_p->release();
+    }
+
+    SharedRef& operator=(const SharedRef& other)
+    {
+        SharedRef copy(other);
+        std::swap(m_p, copy.m_p);
+        return *this;
+    }
+
+    T* get() const
+    {
+        return m_p;
+    }
+
+    T* operator->() const
+    {
+        return m_p;
+    }
+
+protected:
+    T* m_p;
+};
+
+/// Contents of an input file as parsed once: never modified after it is shared
+template <class Value>
+class ParsedFile
+{
+public:
+    typedef std::map<std::string, Value> Map;
+
+    ParsedFile() : found(false), m_refs(0) {}
+
+    void addRef() const
+    {
+        atomicIncrement(m_refs);
+    }
+
+    void release() const
+    {
+        if (atomicDecrement(m_refs) == 0)
+            delete this;
+    }
+
+    /// The value of the key, or NULL
+    const Value* find(const std::string& key) const
+    {
+        typename Map::const_iterator it = vars.find(key);
+        return it != vars.end() ? &it->second : NULL;
+    }
+
+    Map vars;
+    bool found;     ///< the file could be read
+
+private:
+    mutable volatile AtomicCount m_refs;
+};
+
+/// Files parsed by any of the resolutions sharing the table, assumed not to change while
+/// it lives. Lookups take no lock: they read an immutable snapshot of the table. A new
+/// file is added to a copy of the snapshot under the mutex, and the copy is published;
+/// the old snapshots are only freed with the table, as a lookup may still be reading one
+template <class Value>
+class SharedFiles
+{
+public:
+    typedef ParsedFile<Value> File;
+    typedef SharedRef<const File> FileRef;
+
+    SharedFiles() : m_table(new Table) {}
+
+    ~SharedFiles()
+    {
+        for (size_t i = 0; i < m_retired.size(); ++i)
+            delete m_retired[i];
+        delete m_table;
+    }
+
+    /// The file, or a null reference if not parsed yet
+    FileRef find(const std::string& path) const
+    {
+        const Table* table = atomicLoad(m_table);
+        typename Table::const_iterator it = table->find(path);
+        return it != table->end() ? it->second : FileRef();
+    }
+
+    /// Shares a file parsed by a resolution, unless another one did it in the meantime:
+    /// the file kept is returned
+    FileRef insert(const std::string& path, File* file)
+    {
+        FileRef ref(file);
+        MutexLock lock(m_mutex);
+        typename Table::const_iterator it = m_table->find(path);
+        if (it != m_table->end())
+            return it->second;
+
+        Table* previous = m_table;
+        Table* table = new Table(*previous);
+        (*table)[path] = ref;
+        m_retired.push_back(previous);
+        atomicStore(m_table, table);
+        return ref;
+    }
+
+protected:
+    typedef std::map<std::string, FileRef> Table;
+
+    Table* volatile m_table;
+    std::vector<Table*> m_retired;
+    Mutex m_mutex;
+
+private:
+    SharedFiles(const SharedFiles&);
+    SharedFiles& operator=(const SharedFiles&);
+};
+
+/// Inputs parsed once for all the resolutions of a WxConfigCache
+struct SharedInputs
+{
+    SharedFiles<std::string> buildFiles;    ///< build.cfg and config.*
+    SharedFiles<bool> setupHs;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Program options
+class Options
+{
+public:
+    std::string& operator[](const std::string& key)
+    {
+        size_t count = m_vars.size();
+        std::string& value = m_vars[key];
+        if (g_stats.enabled)
+        {
+            ++g_stats.optionLookups;
+            if (m_vars.size() != count)
+                ++g_stats.optionInserts;
+        }
+        return value;
+    }
+
+    bool keyExists(const std::string& key) const
+    {
+        if (g_stats.enabled)
+            ++g_stats.optionLookups;
+        return m_vars.count(key) != 0;
+    }
+    
+    const std::string& keyValue(const std::string& key) const
+    {
+        if (g_stats.enabled)
+            ++g_stats.optionLookups;
+        return m_vars.find(key)->second;
+    }
+
+    std::map<std::string,std::string>& getVars()
+    {
+        return m_vars;
+    }
+protected:
+    std::map<std::string,std::string> m_vars;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Non-owning view of a piece of text, only valid while its buffer is alive
+struct TextView
+{
+    TextView() : begin(NULL), end(NULL) {}
+    TextView(const char* b, const char* e) : begin(b), end(e) {}
+
+    size_t length() const
+    {
+        return end - begin;
+    }
+
+    bool contains(char c) const
+    {
+        return begin != end && memchr(begin, c, end - begin) != NULL;
+    }
+
+    const char* begin;
+    const char* end;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Scans a buffer line by line with memchr(), without copying anything
+class LineLexer
+{
+public:
+    LineLexer(const TextView& text) : m_pos(text.begin), m_end(text.end), m_done(false) {}
+
+    /// Gets the next line without its end of line, as the text mode would do
+    bool next(TextView& line)
+    {
+        if (m_done)
+            return false;
+
+        const char* eol = m_pos != m_end ? (const char*)memchr(m_pos, '\n', m_end - m_pos) : NULL;
+        if (!eol)
+        {
+            eol = m_end;
+            m_done = true;
+        }
+
+        line.begin = m_pos;
+        line.end = eol;
+        if (line.end != line.begin && *(line.end - 1) == '\r')
+            --line.end;
+
+        m_pos = m_done ? m_end : eol + 1;
+        return true;
+    }
+
+protected:
+    const char* m_pos;
+    const char* m_end;
+    bool m_done;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Read-only contents of a whole file, mapped in memory when possible
+class MappedFile
+{
+public:
+    MappedFile() : m_data(NULL), m_size(0), m_mapped(false) {}
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (m_mapped)
+            UnmapViewOfFile(m_data);
+#else
+        if (m_mapped)
+            munmap((void*)m_data, m_size);
+#endif
+        else
+            free((void*)m_data);
+    }
+
+    bool open(const std::string& filepath)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        DWORD size = GetFileSize(file, NULL);
+        if (size != INVALID_FILE_SIZE && size > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping)
+            {
+                m_data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                m_mapped = m_data != NULL;
+                if (m_mapped)
+                    m_size = size;
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+
+        if (!m_mapped && size != INVALID_FILE_SIZE && size > 0)
+            return readAll(filepath, size);
+        return true;
+#else
+        int fd = ::open(filepath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                m_data = (const char*)data;
+                m_size = st.st_size;
+                m_mapped = true;
+            }
+            else
+            {
+                ::close(fd);
+                return readAll(filepath, st.st_size);
+            }
+        }
+        ::close(fd);
+        return true;
+#endif
+    }
+
+    TextView text() const
+    {
+        return TextView(m_data, m_data + m_size);
+    }
+
+protected:
+    /// Fallback for the files that can't be mapped, as on some network and FUSE file
+    /// systems. The prefetch threads call it: the buffer is sized from the size of the
+    /// file and allocated with malloc(), never through the counting operator new
+    bool readAll(const std::string& filepath, size_t size)
+    {
+        FILE* file = fopen(filepath.c_str(), "rb");
+        if (!file)
+            return false;
+
+        /// One more byte to see the end of the file, which may have grown since
+        size_t capacity = size + 1;
+        size_t length = 0;
+        char* buffer = (char*)malloc(capacity);
+        size_t count;
+        while (buffer && (count = fread(buffer + length, 1, capacity - length, file)) > 0)
+        {
+            length += count;
+            if (length == capacity)
+            {
+                capacity *= 2;
+                char* grown = (char*)realloc(buffer, capacity);
+                if (!grown)
+                    free(buffer);
+                buffer = grown;
+            }
+        }
+
+        bool ok = buffer && !ferror(file);
+        fclose(file);
+        if (!ok)
+        {
+            free(buffer);
+            return false;
+        }
+        m_data = buffer;
+        m_size = length;
+        return true;
+    }
+
+    const char* m_data;     ///< mapped, or else allocated with malloc()
+    size_t m_size;
+    bool m_mapped;
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Probes and reads issued at once by a small pool of threads, for the prefixes on network
+/// drives where each of them is a round trip. Each result can be waited for, and used, as
+/// soon as it arrives. The threads never call operator new, whose counters aren't thread
+/// safe: the requests and their MappedFile are allocated beforehand, and the files that
+/// can't be mapped are read into a buffer of malloc()
+class Prefetch
+{
+public:
+    struct Request
+    {
+        Request(const std::string& p, bool r) : path(p), read(r), exists(false), file(r ? new MappedFile : NULL) {}
+
+        std::string path;
+        bool read;          ///< maps the file, else only stat()s it
+        bool exists;
+        MappedFile* file;   ///< taken by the FileCache once done
+        Completion done;
+    };
+
+    enum { MaxThreads = 16 };
+
+    /// The threads that start share the requests; if none does, the requests are done
+    /// here, one after the other, rather than never signalled
+    Prefetch(const std::vector<Request*>& requests) : m_requests(requests), m_next(0)
+    {
+        size_t count = std::min<size_t>(m_requests.size(), MaxThreads);
+        for (size_t i = 0; i < count; ++i)
+        {
+            Thread* thread = new Thread(work, this);
+            if (!thread->started())
+            {
+                delete thread;
+                break;
+            }
+            m_threads.push_back(thread);
+        }
+        if (m_threads.empty())
+            work(this);
+    }
+
+    ~Prefetch()
+    {
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_threads[i]->join();
+            delete m_threads[i];
+        }
+        for (size_t i = 0; i < m_requests.size(); ++i)
+        {
+            delete m_requests[i]->file;
+            delete m_requests[i];
+        }
+    }
+
+protected:
+    static void work(void* self)
+    {
+        Prefetch& prefetch = *(Prefetch*)self;
+        for (;;)
+        {
+            size_t index = atomicIncrement(prefetch.m_next) - 1;
+            if (index >= prefetch.m_requests.size())
+                return;
+
+            Request& request = *prefetch.m_requests[index];
+            if (request.read)
+                request.exists = request.file->open(request.path);
+            else
+            {
+                struct stat st;
+                request.exists = stat(request.path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+            }
+            request.done.signal();
+        }
+    }
+
+    std::vector<Request*> m_requests;
+    std::vector<Thread*> m_threads;
+    volatile AtomicCount m_next;
+
+private:
+    Prefetch(const Prefetch&);
+    Prefetch& operator=(const Prefetch&);
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Per-run cache of the input files: each file is probed with a single stat() and mapped
+/// at most once, and the same buffer is shared by the validation and the parsing
+class FileCache
+{
+public:
+    ~FileCache()
+    {
+        clear();
+    }
+
+    /// Forgets every file, the next requests hit the file system again
+    void clear()
+    {
+        for (size_t i = 0; i < m_prefetches.size(); ++i)
+            delete m_prefetches[i];
+        m_prefetches.clear();
+        for (std::map<std::string, Entry>::iterator it = m_files.begin(); it != m_files.end(); ++it)
+            delete it->second.file;
+        m_files.clear();
+    }
+
+    /// Issues the reads and the probes of files not requested yet all at once, instead of
+    /// one after the other when they are requested
+    void prefetch(const std::vector<std::string>& reads, const std::vector<std::string>& probes)
+    {
+        std::vector<Prefetch::Request*> requests;
+        for (size_t i = 0; i < reads.size() + probes.size(); ++i)
+        {
+            bool read = i < reads.size();
+            const std::string& path = read ? reads[i] : probes[i - reads.size()];
+            Entry& entry = m_files[path];
+            if (entry.pending || entry.loaded || (!read && entry.probed))
+                continue;
+            entry.pending = new Prefetch::Request(path, read);
+            requests.push_back(entry.pending);
+        }
+        if (!requests.empty())
+            m_prefetches.push_back(new Prefetch(requests));
+    }
+
+    /// Returns true if the file exists and is a regular file
+    bool exists(const std::string& filepath)
+    {
+        Entry& entry = m_files[filepath];
+        ++entry.probes;
+        settle(entry);
+        if (!entry.probed)
+        {
+            ++entry.stats;
+            struct stat st;
+            entry.exists = stat(filepath.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+            entry.probed = true;
+        }
+        return entry.exists;
+    }
+
+    /// Gets the contents of the file, returns false if it can't be read
+    bool contents(const std::string& filepath, TextView& text)
+    {
+        Entry& entry = m_files[filepath];
+        ++entry.reads;
+        settle(entry);
+        if (!entry.loaded)
+        {
+            entry.loaded = true;
+            if (!entry.probed || entry.exists)
+            {
+                ++entry.opens;
+                entry.file = new MappedFile;
+                if (!entry.file->open(filepath))
+                {
+                    delete entry.file;
+                    entry.file = NULL;
+                }
+            }
+            entry.probed = true;
+            entry.exists = entry.file != NULL;
+        }
+
+        if (!entry.file)
+            return false;
+
+        text = entry.file->text();
+        return true;
+    }
+
+    /// The files whose contents were asked for, found or not
+    void readFiles(std::vector<std::string>& paths) const
+    {
+        for (std::map<std::string, Entry>::const_iterator it = m_files.begin(); it != m_files.end(); ++it)
+            if (it->second.reads)
+                paths.push_back(it->first);
+    }
+
+    /// Number of probes asked for, and of stat() calls actually made for them
+    void probeCounts(unsigned long& probes, unsigned long& stats) const
+    {
+        probes = stats = 0;
+        for (std::map<std::string, Entry>::const_iterator it = m_files.begin(); it != m_files.end(); ++it)
+        {
+            probes += it->second.probes;
+            stats += it->second.stats;
+        }
+    }
+
+    /// Lists every file asked for, with the number of requests and whether the file
+    /// system was hit: one stat() per probed file and one open per read file at most.
+    /// The files prefetched but never asked for are listed as unused
+    void report(FILE* stream) const
+    {
+        unsigned long probes = 0, stats = 0, reads = 0, opens = 0;
+        for (std::map<std::string, Entry>::const_iterator it = m_files.begin(); it != m_files.end(); ++it)
+        {
+            const Entry& entry = it->second;
+            probes += entry.probes;
+            stats += entry.stats;
+            reads += entry.reads;
+            opens += entry.opens;
+            fprintf(stream, "    %-7s probes %lu (%lu hits)  reads %lu (%lu hits)  %s\n",
+                    entry.pending ? "unused" : entry.exists ? "found" : "missing", entry.probes, entry.probes - entry.stats,
+                    entry.reads, hits(entry.reads, entry.opens), it->first.c_str());
+        }
+        fprintf(stream, "  %-24s %lu (%lu hits, %lu misses)\n", "files probed", probes, hits(probes, stats), stats);
+        fprintf(stream, "  %-24s %lu (%lu hits, %lu misses)\n", "files read", reads, hits(reads, opens), opens);
+    }
+
+protected:
+    struct Entry
+    {
+        Entry() : probed(false), exists(false), loaded(false), file(NULL), pending(NULL), probes(0), reads(0), stats(0), opens(0) {}
+
+        bool probed;
+        bool exists;
+        bool loaded;
+        MappedFile* file;
+        Prefetch::Request* pending;     ///< prefetch not accounted yet
+        unsigned long probes;
+        unsigned long reads;
+        unsigned long stats;    ///< stat() calls actually made
+        unsigned long opens;    ///< opens actually made
+    };
+
+    /// A prefetched read also answers the probes, and may never be asked for itself
+    static unsigned long hits(unsigned long requests, unsigned long misses)
+    {
+        return requests > misses ? requests - misses : 0;
+    }
+
+    /// Waits for the prefetch of the file, if any, and takes its result
+    void settle(Entry& entry)
+    {
+        Prefetch::Request* request = entry.pending;
+        if (!request)
+            return;
+
+        request->done.wait();
+        entry.pending = NULL;
+        entry.probed = true;
+        entry.exists = request->exists;
+        if (request->read)
+        {
+            ++entry.opens;
+            entry.loaded = true;
+            if (request->exists)
+            {
+                entry.file = request->file;
+                request->file = NULL;
+            }
+        }
+        else
+            ++entry.stats;
+    }
+
+    std::map<std::string, Entry> m_files;
+    std::vector<Prefetch*> m_prefetches;
+};
+
+/// State of one resolution: nothing is shared between two of them, but the parsed
+/// inputs of a WxConfigCache
+struct RunContext
+{
+    /// Whether the files are prefetched; Auto is decided on the prefix, by resolveQuery()
+    enum PrefetchMode
+    {
+        PrefetchAuto,
+        PrefetchNever,
+        PrefetchAlways
+    };
+
+    /// Build profile (--profile), and for the optimized one the phase of a profile-guided
+    /// optimization (optimized:instrument or optimized:use)
+    enum Profile
+    {
+        ProfileNone,
+        ProfileFastbuild,
+        ProfileOptimized
+    };
+
+    enum Pgo
+    {
+        PgoNone,
+        PgoInstrument,
+        PgoUse
+    };
+
+    RunContext(SharedInputs* shared = NULL)
+        : easyMode(false), profile(ProfileNone), pgo(PgoNone), inputs(shared), prefetch(PrefetchAuto) {}
+
+    /// The name of the profile, as --profile takes it
+    const char* profileName() const
+    {
+        return profile == ProfileFastbuild ? "fastbuild" : profile == ProfileOptimized ? "optimized" : "";
+    }
+
+    bool easyMode;
+    Profile profile;
+    Pgo pgo;
+    FileCache files;
+    std::vector<WxConfigMessage> messages;  ///< the non fatal ones, in order
+    SharedInputs* inputs;                   ///< NULL to parse the files of this resolution
+    PrefetchMode prefetch;
+
+    /// The flags of po["cflags"], po["libs"] and po["rcflags"], one argument each
+    std::vector<std::string> cflagArgs;
+    std::vector<std::string> libArgs;
+    std::vector<std::string> rcflagArgs;
+};
+
+/// Thrown on the errors that stop a resolution, in place of exit()
+class WxConfigException : public std::exception
+{
+public:
+    WxConfigException(WxConfigError::Code code, const std::string& text, const std::string& hint = "")
+        : m_error(code, text, hint) {}
+
+    ~WxConfigException() WXCONFIG_NOTHROW {}
+
+    const char* what() const WXCONFIG_NOTHROW
+    {
+        return m_error.text.c_str();
+    }
+
+    const WxConfigError& error() const
+    {
+        return m_error;
+    }
+
+protected:
+    WxConfigError m_error;
+};
+
+/// Files of the run reported by --stats
+static const FileCache* g_reportedFiles = NULL;
+
+/// Prints the counters, also when the run ends through exit()
+void reportStats()
+{
+    fprintf(stderr, "wx-config stats:\n");
+    if (g_reportedFiles)
+        g_reportedFiles->report(stderr);
+    fprintf(stderr, "  %-24s %lu (%lu distinct)\n", "candidate configurations", g_stats.candidates, g_stats.distinctCandidates);
+    fprintf(stderr, "  %-24s %lu\n", "build.cfg lines", g_stats.buildCfgLines);
+    fprintf(stderr, "  %-24s %lu\n", "setup.h lines", g_stats.setupHLines);
+    if (g_stats.stagedFiles)
+        fprintf(stderr, "  %-24s %lu (%lu up to date)\n", "staged files", g_stats.stagedFiles, g_stats.stagedCurrent);
+    fprintf(stderr, "  %-24s %lu (%lu inserts)\n", "options lookups", g_stats.optionLookups, g_stats.optionInserts);
+#if defined(WXCONFIG_COUNT_ALLOCATIONS) && !defined(WXCONFIG_LIBRARY)
+    fprintf(stderr, "  %-24s %lu (%lu bytes)\n", "heap allocations", g_stats.allocations, g_stats.allocatedBytes);
+    fprintf(stderr, "  %-24s %lu bytes\n", "peak heap", g_stats.heapPeak);
+#else
+    fprintf(stderr, "  %-24s %s\n", "heap allocations", "not counted (build with WXCONFIG_COUNT_ALLOCATIONS)");
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// File build.cfg/config.* options
+class BuildFileOptions : public Options
+{
+public:
+    BuildFileOptions() {}
+
+    BuildFileOptions(RunContext& ctx, const std::string& filepath)
+    {
+        parse(ctx, filepath);
+    }
+
+    typedef ParsedFile<std::string> File;
+
+    /// With shared inputs, the file is parsed once for all the resolutions and only
+    /// referenced here: the keys this resolution reads or sets are copied in m_vars
+    bool parse(RunContext& ctx, const std::string& filepath)
+    {
+        TraceSpan span("parse build.cfg", "file", filepath);
+        if (ctx.inputs)
+            return addShared(ctx, filepath);
+
+        TextView text;
+        if (ctx.files.contents(filepath, text))
+            return parse(text);
+
+        ctx.messages.push_back(WxConfigMessage(WxConfigMessage::Error, "Unable to open file '" + filepath + "'."));
+        return false;
+    }
+
+    /// Parses contents already in memory
+    bool parse(const TextView& text)
+    {
+        LineLexer lexer(text);
+        TextView line;
+        while (lexer.next(line))
+        {
+            if (g_stats.enabled)
+                ++g_stats.buildCfgLines;
+
+            // it's a comment line
+            if (line.contains('#'))
+                continue;
+
+            split(line);
+        }
+
+        return !m_vars.empty();
+    }
+
+    /// The value of the key, taken on first use from the shared files, the last one parsed
+    /// first as it would have overwritten the others
+    std::string& operator[](const std::string& key)
+    {
+        size_t count = m_vars.size();
+        std::string& value = Options::operator[](key);
+        if (m_vars.size() != count && !m_shared.empty())
+        {
+            const std::string* shared = findShared(key);
+            if (shared)
+                value = *shared;
+        }
+        return value;
+    }
+
+    bool keyExists(const std::string& key) const
+    {
+        return Options::keyExists(key) || findShared(key) != NULL;
+    }
+
+protected:
+    bool addShared(RunContext& ctx, const std::string& filepath)
+    {
+        SharedFiles<std::string>::FileRef file = ctx.inputs->buildFiles.find(filepath);
+        if (!file.get())
+        {
+            File* parsed = new File;
+            TextView text;
+            if (ctx.files.contents(filepath, text))
+            {
+                BuildFileOptions cfg;
+                cfg.parse(text);
+                parsed->vars.swap(cfg.m_vars);
+                parsed->found = true;
+            }
+            file = ctx.inputs->buildFiles.insert(filepath, parsed);
+        }
+
+        if (!file->found)
+        {
+            ctx.messages.push_back(WxConfigMessage(WxConfigMessage::Error, "Unable to open file '" + filepath + "'."));
+            return false;
+        }
+
+        m_shared.push_back(file);
+        return !file->vars.empty();
+    }
+
+    const std::string* findShared(const std::string& key) const
+    {
+        for (size_t i = m_shared.size(); i > 0; --i)
+        {
+            const std::string* value = m_shared[i - 1]->find(key);
+            if (value)
+                return value;
+        }
+        return NULL;
+    }
+
+    std::vector<SharedFiles<std::string>::FileRef> m_shared;
+
+    /// Splits a KEY=VALUE line, skipping the spaces
+    void split(const TextView& line)
+    {
+        const char* sep = (const char*)memchr(line.begin, '=', line.length());
+        if (sep)
+        {
+            std::string key;
+            appendNonSpace(key, line.begin, sep);
+            appendNonSpace(m_vars[key], sep + 1, line.end);
+        }
+    }
+
+    static void appendNonSpace(std::string& str, const char* begin, const char* end)
+    {
+        str.clear();
+        for (const char* c = begin; c != end; ++c)
+            if (*c != ' ')
+                str += *c;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// File setup.h options
+class SetupHOptions
+{
+public:
+    /// As with BuildFileOptions, the keys of a shared setup.h are copied on first use
+    bool& operator[](const std::string& key)
+    {
+        size_t count = m_vars.size();
+        bool& value = m_vars[key];
+        if (m_vars.size() != count && m_shared.get())
+        {
+            const bool* shared = m_shared->find(key);
+            if (shared)
+                value = *shared;
+        }
+        return value;
+    }
+
+    bool keyExists(const std::string& key) const
+    {
+        return m_vars.count(key) != 0 || (m_shared.get() && m_shared->find(key));
+    }
+    
+    bool keyValue(const std::string& key) const
+    {
+        StringBoolMap::const_iterator it = m_vars.find(key);
+        return it != m_vars.end() ? it->second : *m_shared->find(key);
+    }
+    
+    typedef std::map<std::string,bool> StringBoolMap;
+    typedef ParsedFile<bool> File;
+    
+    StringBoolMap& getVars()
+    {
+        return m_vars;
+    }
+protected:
+    StringBoolMap m_vars;
+    SharedFiles<bool>::FileRef m_shared;
+
+    
+public:
+    SetupHOptions() {}
+
+    SetupHOptions(RunContext& ctx, const std::string& filepath)
+    {
+        parse(ctx, filepath);
+    }
+
+    bool parse(RunContext& ctx, const std::string& filepath)
+    {
+        TraceSpan span("parse setup.h", "file", filepath);
+        if (ctx.inputs)
+            return addShared(ctx, filepath);
+
+        TextView text;
+        if (ctx.files.contents(filepath, text))
+            return parse(text);
+
+        ctx.messages.push_back(WxConfigMessage(WxConfigMessage::Error, "Unable to open file '" + filepath + "'."));
+        return false;
+    }
+
+    /// Parses contents already in memory
+    bool parse(const TextView& text)
+    {
+        LineLexer lexer(text);
+        TextView line;
+        while (lexer.next(line))
+        {
+            if (g_stats.enabled)
+                ++g_stats.setupHLines;
+
+            // does the splitting/parsing
+            split(line);
+        }
+
+        return !m_vars.empty();
+    }
+    
+    void printDebug()
+    {
+        std::cout << "DEBUG: setup.h contents BEGIN -------------------------------------------------" << std::endl;
+        for (StringBoolMap::iterator it = m_vars.begin(); it != m_vars.end(); ++it)
+            std::cout << it->first << "=" << it->second << std::endl;
+        std::cout << "DEBUG: setup.h contents END ---------------------------------------------------" << std::endl;
+    }
+
+protected:
+    bool addShared(RunContext& ctx, const std::string& filepath)
+    {
+        SharedFiles<bool>::FileRef file = ctx.inputs->setupHs.find(filepath);
+        if (!file.get())
+        {
+            File* parsed = new File;
+            TextView text;
+            if (ctx.files.contents(filepath, text))
+            {
+                SetupHOptions sho;
+                sho.parse(text);
+                parsed->vars.swap(sho.m_vars);
+                parsed->found = true;
+            }
+            file = ctx.inputs->setupHs.insert(filepath, parsed);
+        }
+
+        if (!file->found)
+        {
+            ctx.messages.push_back(WxConfigMessage(WxConfigMessage::Error, "Unable to open file '" + filepath + "'."));
+            return false;
+        }
+
+        m_shared = file;
+        return !file->vars.empty();
+    }
+
+    /// Parses a '#define KEY 0|1' line in place: the spaces and tabs are skipped,
+    /// and the key is only copied once the line is known to be retained
+    void split(const TextView& line)
+    {
+        // it's a comment line
+        if (line.contains('/'))
+            return; // skips the line
+
+        // locates, ignoring spaces and tabs, the first char of "#define",
+        // the last char and the length of the line
+        static const char tokDefine[] = "#define";
+        const size_t tokDefineLength = sizeof(tokDefine) - 1;
+        size_t length = 0;
+        size_t posDefine = std::string::npos;
+        char lastChar = 0;
+        for (const char* c = line.begin; c != line.end; ++c)
+        {
+            if (*c == ' ' || *c == '\t')
+                continue;
+            if (posDefine == std::string::npos && memchr(tokDefine, *c, tokDefineLength))
+                posDefine = length;
+            lastChar = *c;
+            ++length;
+        }
+
+        // it's a #define line
+        if (posDefine != std::string::npos)
+        {
+            bool val;
+
+            // resolves val, checking if last char is 0 or 1
+            if (lastChar == '0')
+                val = false;
+            else if (lastChar == '1')
+                val = true;
+            else
+                return; // skips the line
+
+            // resolves key, everything after "#define" but the last char
+            size_t startPos = posDefine + tokDefineLength;
+            if (startPos > length)
+                return; // skips the line
+
+            std::string key;
+            size_t pos = 0;
+            for (const char* c = line.begin; c != line.end; ++c)
+            {
+                if (*c == ' ' || *c == '\t')
+                    continue;
+                if (pos >= startPos && pos + 1 < length)
+                    key += *c;
+                ++pos;
+            }
+
+            // finally saves the parsed data!
+            m_vars[key] = val;
+        }
+    }
+};
+
+
+// -------------------------------------------------------------------------------------------------
+
+/// Options of the command line, in the order of g_options
+enum OptionId
+{
+    OptionPrefix,
+    OptionWxcfg,
+    OptionDebug,
+    OptionUnicode,
+    OptionStatic,
+    OptionUniversal,
+    OptionCompiler,
+    OptionProfile,
+    OptionEasyMode,
+    OptionDefineVariable,
+    OptionCflags,
+    OptionCxxflags,
+    OptionCppflags,
+    OptionRcflags,
+    OptionLibs,
+    OptionRuntimeDeps,
+    OptionStage,
+    OptionVariable,
+    OptionRelease,
+    OptionVersion,
+    OptionBasename,
+    OptionCc,
+    OptionCxx,
+    OptionLd,
+    OptionRevision,
+    OptionList,         ///< accepted as it always was, but not implemented nor documented
+    OptionExec,         ///< only documented: main() takes 'exec' off the command line
+    OptionTraceTiming,
+    OptionStats,
+    OptionTraceOut,
+    OptionOutput,
+    OptionWatch,
+    OptionHelp,
+    OptionCount
+};
+
+/// Options selecting the configuration, options asking for an output, and options of the
+/// run itself, which alone don't make a valid command line
+enum OptionGroup
+{
+    GroupSelection,
+    GroupOutput,
+    GroupRun
+};
+
+/// How an option takes a value, after a '='
+enum OptionValue
+{
+    ValueNone,
+    ValueOptional,
+    ValueRequired
+};
+
+/// Values of --compiler, in the order of the option's values
+enum CompilerDriver
+{
+    DriverGcc,
+    DriverDmc,
+    DriverVc,
+    DriverWat,
+    DriverBcc,
+    DriverClang,
+    DriverClangCL
+};
+
+/// An option of the command line, as parsed and as documented by the usage
+struct OptionSpec
+{
+    const char* name;
+    OptionGroup group;
+    OptionValue value;
+    const char* values;     ///< the accepted values separated by '|', NULL for any
+    const char* syntax;     ///< of the value in the usage, NULL to list the accepted values
+    const char* help;       ///< lines of the usage, separated by '\n', NULL to leave it out
+};
+
+const OptionSpec g_options[] =
+{
+    { "--prefix", GroupSelection, ValueOptional, NULL, "[=DIR]",
+      "Path of the wxWidgets installation (ie. C:\\wxWidgets2.6.3),\n"
+      "or a search path of installations separated by ';' (or ':'\n"
+      "but on Windows), the first one with the configuration winning." },
+    { "--wxcfg", GroupSelection, ValueOptional, NULL, "[=DIR]",
+      "Relative path of the build.cfg file (ie. gcc_dll\\mswud)" },
+    { "--debug", GroupSelection, ValueOptional, "yes|no", NULL,
+      "Uses a debug configuration if found." },
+    { "--unicode", GroupSelection, ValueOptional, "yes|no", NULL,
+      "Uses an unicode configuration if found." },
+    { "--static", GroupSelection, ValueOptional, "yes|no", NULL,
+      "Uses a static configuration if found." },
+    { "--universal", GroupSelection, ValueOptional, "yes|no", NULL,
+      "Uses an universal configuration if found." },
+    { "--compiler", GroupSelection, ValueRequired, "gcc|dmc|vc|wat|bcc|clang|clang-cl", NULL,
+      "Selects the compiler. clang and clang-cl link with lld, using\n"
+      "a gcc or vc configuration." },
+    { "--profile", GroupSelection, ValueRequired, "fastbuild|optimized|optimized:instrument|optimized:use", "=PROFILE",
+      "Adds the flags of a build profile, keeping the ABI of the\n"
+      "configuration: fastbuild, for the fastest edit-compile-link\n"
+      "turnaround; optimized, for link-time optimization; and\n"
+      "optimized:instrument then optimized:use, for a profile-guided\n"
+      "one." },
+    { "--easymode", GroupSelection, ValueOptional, "yes|no", NULL,
+      "Adds warning and optimization flags, and the samples to the\n"
+      "include paths." },
+    { "--define-variable", GroupSelection, ValueRequired, NULL, "=NAME=VAL",
+      "Sets a global value for a variable." },
+    { "--cflags", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs all pre-processor and compiler flags." },
+    { "--cxxflags", GroupOutput, ValueNone, NULL, NULL,
+      "Same as --cflags but for C++." },
+    { "--cppflags", GroupOutput, ValueNone, NULL, NULL,
+      "Same as --cflags, which include the pre-processor flags." },
+    { "--rcflags", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs all resource compiler flags. [UNTESTED]" },
+    { "--libs", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs all linker flags, for the libraries listed after the\n"
+      "options as in 'base,net', or else std." },
+    { "--runtime-deps", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the DLLs of these libraries needed at run time, one\n"
+      "absolute path per line (none for a static configuration)." },
+    { "--stage", GroupOutput, ValueRequired, NULL, "=DIR",
+      "Hardlinks the DLLs of --runtime-deps into DIR, or copies them\n"
+      "where it can't, skipping those already up to date." },
+    { "--variable", GroupOutput, ValueRequired, NULL, "=NAME",
+      "Returns the value of a defined variable." },
+    { "--release", GroupOutput, ValueOptional, NULL, "[=X.Y]",
+      "Outputs the wxWidgets release number. With X.Y, selects the\n"
+      "first prefix of the search path with this release instead." },
+    { "--version", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the wxWidgets version." },
+    { "--basename", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the base name of the wxWidgets libraries." },
+    { "--cc", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the name of the C compiler." },
+    { "--cxx", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the name of the C++ compiler." },
+    { "--ld", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the linker command." },
+    { "-v", GroupOutput, ValueNone, NULL, NULL,
+      "Outputs the revision of wx-config." },
+    { "--list", GroupOutput, ValueNone, NULL, NULL, NULL },
+    { "exec", GroupRun, ValueNone, NULL, " [options] -- TOOL ARGS",
+      "Runs TOOL with the --cflags, --libs or --rcflags\n"
+      "appended to its ARGS, without a shell." },
+    { "--trace-timing", GroupRun, ValueNone, NULL, NULL,
+      "Prints the time spent by each phase to stderr." },
+    { "--stats", GroupRun, ValueNone, NULL, NULL,
+      "Prints counters of the work done to stderr." },
+    { "--trace-out", GroupRun, ValueRequired, NULL, "=FILE|DIR",
+      "Writes a Chrome trace of the run (DIR/wx-config-<pid>.json)." },
+    { "--output", GroupRun, ValueRequired, NULL, "=FILE",
+      "Writes the output to FILE instead, replacing it atomically\n"
+      "and only when it changes." },
+    { "--watch", GroupRun, ValueNone, NULL, NULL,
+      "With --output, keeps FILE up to date: resolves again each\n"
+      "time a build.cfg, setup.h or config.* read changes." },
+    { "--help", GroupRun, ValueNone, NULL, NULL,
+      "Prints this help." }
+};
+
+/// Fails to compile if g_options and OptionId don't have the same number of options
+typedef char OptionsMatchOptionIds[sizeof(g_options) / sizeof(g_options[0]) == OptionCount ? 1 : -1];
+
+/// Perfect hash of the option names, so that finding an option is one hash and one
+/// comparison. The table is fixed, but C++98 can't hash string literals at compile time:
+/// the seed giving each name a slot of its own is searched once, by the first parsing
+class OptionTable
+{
+public:
+    OptionTable() : m_seed(0)
+    {
+        for (size_t i = 0; i < OptionCount; ++i)
+            m_lengths[i] = strlen(g_options[i].name);
+        while (!fill())
+            ++m_seed;
+    }
+
+    /// The option with the name, OptionCount if none
+    OptionId find(const TextView& name) const
+    {
+        unsigned char slot = m_slots[hash(name.begin, name.length())];
+        if (slot == 0)
+            return OptionCount;
+
+        size_t id = slot - 1;
+        if (m_lengths[id] != name.length() || memcmp(g_options[id].name, name.begin, m_lengths[id]) != 0)
+            return OptionCount;
+        return OptionId(id);
+    }
+
+private:
+    enum { Slots = 256 };
+
+    /// FNV-1a from a seeded basis
+    size_t hash(const char* text, size_t length) const
+    {
+        unsigned long h = 2166136261UL ^ m_seed;
+        for (size_t i = 0; i < length; ++i)
+        {
+            h ^= static_cast<unsigned char>(text[i]);
+            h = (h * 16777619UL) & 0xffffffffUL;
+        }
+        return (h ^ (h >> 16)) & (Slots - 1);
+    }
+
+    /// False if two options share a slot with the current seed
+    bool fill()
+    {
+        memset(m_slots, 0, sizeof(m_slots));
+        for (size_t i = 0; i < OptionCount; ++i)
+        {
+            size_t slot = hash(g_options[i].name, m_lengths[i]);
+            if (m_slots[slot] != 0)
+                return false;
+            m_slots[slot] = static_cast<unsigned char>(i + 1);
+        }
+        return true;
+    }
+
+    unsigned long m_seed;
+    size_t m_lengths[OptionCount];
+    unsigned char m_slots[Slots];   ///< option + 1, 0 for none
+};
+
+/// Built on first use rather than before main(): a program linking the resolver may call
+/// it from a static initializer of its own, which can run before those of this file
+static const OptionTable* volatile g_optionTable = NULL;
+
+/// Concurrent first parsings each build the table, and only the first one published is kept
+const OptionTable& optionTable()
+{
+    const OptionTable* table = atomicLoad(g_optionTable);
+    if (table)
+        return *table;
+
+    OptionTable* built = new OptionTable;
+    if (atomicPublish(g_optionTable, static_cast<const OptionTable*>(built)))
+        return *built;
+    delete built;
+    return *atomicLoad(g_optionTable);
+}
+
+/// Command line options: each argument is one of g_options, or a comma separated list of
+/// libraries. Parsing doesn't allocate: the values are views of the arguments, which must
+/// outlive the options. The first invalid argument stops the parsing
+class CmdLineOptions
+{
+public:
+    enum Error
+    {
+        ErrorNone,
+        ErrorUnknown,           ///< not an option
+        ErrorUnexpectedValue,   ///< a value for an option which takes none
+        ErrorMissingValue,
+        ErrorInvalidValue       ///< not one of the values of the option
+    };
+
+    CmdLineOptions(int argc, char* argv[]) : m_argc(argc), m_argv(argv), m_strings(NULL)
+    {
+        parse();
+    }
+
+    /// args[0] is the name of the program
+    CmdLineOptions(const std::vector<std::string>& args) : m_argc(args.size()), m_argv(NULL), m_strings(&args)
+    {
+        parse();
+    }
+
+    bool has(OptionId id) const
+    {
+        return m_present[id];
+    }
+
+    /// The value of the option, empty if it has none
+    const TextView& view(OptionId id) const
+    {
+        return m_values[id];
+    }
+
+    /// Same, copied for the values kept
+    std::string value(OptionId id) const
+    {
+        return std::string(m_values[id].begin, m_values[id].end);
+    }
+
+    /// The index of the value among those of the option, 0 (the first) if it was given
+    /// without any
+    size_t choice(OptionId id) const
+    {
+        return m_choices[id];
+    }
+
+    /// The value of a yes|no option, yes if it was given without any
+    bool enabled(OptionId id) const
+    {
+        return m_choices[id] == 0;
+    }
+
+    CompilerDriver compiler() const
+    {
+        return CompilerDriver(m_choices[OptionCompiler]);
+    }
+
+    Error error() const
+    {
+        return m_error;
+    }
+
+    /// The error, quoting the argument
+    std::string errorText() const
+    {
+        TextView text = arg(m_errorArg);
+        std::string quoted = "'" + std::string(text.begin, text.end) + "'";
+        switch (m_error)
+        {
+            case ErrorUnknown:
+                return "Unrecognised option: " + quoted;
+            case ErrorUnexpectedValue:
+                return "Unexpected value of an option without any: " + quoted;
+            case ErrorMissingValue:
+                return "Missing value of the option: " + quoted;
+            case ErrorInvalidValue:
+                return "Invalid value of the option: " + quoted;
+            default:
+                return "";
+        }
+    }
+
+    /// Returns true if the arguments are valid, and at least one of them asks for something
+    bool hasValidArgs() const
+    {
+        if (m_error != ErrorNone)
+            return false;
+
+        for (size_t i = 0; i < OptionCount; ++i)
+            if (m_present[i] && g_options[i].group != GroupRun)
+                return true;
+        return false;
+    }
+
+    /// Same, printing the error and the usage when they aren't
+    bool validArgs() const
+    {
+        if (m_error != ErrorNone)
+            std::cout << g_tokError << errorText() << "\n" << std::endl;
+
+        bool valid = hasValidArgs();
+        if (!valid)
+            printUsage();
+        return valid;
+    }
+
+    /// The libraries of the lists in the arguments, those of 'std' if none
+    void getLibs(std::vector<std::string>& libs) const
+    {
+        for (size_t i = 1; i < m_argc; ++i)
+        {
+            TextView text = arg(i);
+            if (text.length() == 0 || *text.begin == '-')
+                continue;
+
+            // saves comma separated text like "text1,text2,text3,text4"
+            const char* begin = text.begin;
+            for (const char* c = text.begin; c != text.end; ++c)
+            {
+                if (*c == ',')
+                {
+                    libs.push_back(std::string(begin, c));
+                    begin = c + 1;
+                }
+            }
+            libs.push_back(std::string(begin, text.end));
+        }
+
+        // assuming magic keyword 'std' as a lib parameter for non-monolithic
+        // magic keyword std: links with xrc,qa,html,adv,core,base_xml,base_net,base
+        if (libs.empty() || std::find(libs.begin(), libs.end(), "std") != libs.end())
+        {
+            static const char* stdLibs[] = { "xrc", "qa", "html", "adv", "core", "xml", "net", "base" };
+            for (size_t i = 0; i < sizeof(stdLibs) / sizeof(stdLibs[0]); ++i)
+                if (std::find(libs.begin(), libs.end(), stdLibs[i]) == libs.end())
+                    libs.push_back(stdLibs[i]);
+        }
+    }
+
+    /// Prints the options of g_options, and the environment variables
+    static void printUsage()
+    {
+        std::cerr << "Usage: wx-config [options]\n";
+        std::cerr << "Options:\n";
+        for (size_t i = 0; i < OptionCount; ++i)
+        {
+            if (i > 0 && g_options[i].group != g_options[i - 1].group)
+                std::cerr << std::endl;
+            if (g_options[i].help)
+                printOption(g_options[i]);
+        }
+
+        std::cerr << std::endl;
+        std::cerr << "  Note that using --prefix is not needed if you have defined the \n";
+        std::cerr << "  environmental variable WXWIN.\n";
+        std::cerr << std::endl;
+        std::cerr << "  Also note that using --wxcfg is not needed if you have defined the \n";
+        std::cerr << "  environmental variable WXCFG.\n";
+        std::cerr << std::endl;
+        std::cerr << "  The environmental variable WXCONFIG_TRACE_TIMING=1 enables\n";
+        std::cerr << "  --trace-timing on every invocation.\n";
+        std::cerr << std::endl;
+        std::cerr << "  The files of the prefixes on a network drive are read concurrently, all\n";
+        std::cerr << "  the prefixes of a search path at once; WXCONFIG_PREFETCH=1 or 0 forces\n";
+        std::cerr << "  it on or off.\n";
+        std::cerr << std::endl;
+    }
+
+private:
+    /// The option and its value, then its help from the 31st column, on the next line
+    /// if the option is too long
+    static void printOption(const OptionSpec& spec)
+    {
+        std::string option = spec.name;
+        if (spec.syntax)
+            option += spec.syntax;
+        else if (spec.values)
+            option += spec.value == ValueOptional ? "[=" + std::string(spec.values) + "]" : "=" + std::string(spec.values);
+
+        const std::string indent(30, ' ');
+        std::cerr << "  " << option;
+        if (option.size() < 28)
+            std::cerr << std::string(28 - option.size(), ' ');
+        else
+            std::cerr << "\n" << indent;
+
+        for (const char* c = spec.help; *c; ++c)
+        {
+            std::cerr << *c;
+            if (*c == '\n')
+                std::cerr << indent;
+        }
+        std::cerr << "\n";
+    }
+
+    TextView arg(size_t i) const
+    {
+        if (m_strings)
+            return TextView((*m_strings)[i].data(), (*m_strings)[i].data() + (*m_strings)[i].size());
+        return TextView(m_argv[i], m_argv[i] + strlen(m_argv[i]));
+    }
+
+    /// True if the value is one of those of the option, whose index is set in choice
+    static bool accepts(const OptionSpec& spec, const TextView& value, size_t& choice)
+    {
+        choice = 0;
+        if (!spec.values)
+            return true;
+
+        const char* begin = spec.values;
+        while (true)
+        {
+            const char* end = strchr(begin, '|');
+            size_t length = end ? size_t(end - begin) : strlen(begin);
+            if (length == value.length() && memcmp(begin, value.begin, length) == 0)
+                return true;
+            if (!end)
+                return false;
+            begin = end + 1;
+            ++choice;
+        }
+    }
+
+    void fail(Error error, size_t i)
+    {
+        m_error = error;
+        m_errorArg = i;
+    }
+
+    /// An empty argument, as an empty variable of a script gives, is ignored
+    void parse()
+    {
+        memset(m_present, 0, sizeof(m_present));
+        memset(m_choices, 0, sizeof(m_choices));
+        m_error = ErrorNone;
+        m_errorArg = 0;
+
+        for (size_t i = 1; i < m_argc; ++i)
+        {
+            TextView text = arg(i);
+            if (text.length() == 0 || *text.begin != '-')
+                continue;   // a list of libraries
+
+            const char* equal = static_cast<const char*>(memchr(text.begin, '=', text.length()));
+            OptionId id = optionTable().find(TextView(text.begin, equal ? equal : text.end));
+            if (id == OptionCount)
+                return fail(ErrorUnknown, i);
+
+            const OptionSpec& spec = g_options[id];
+            if (equal && spec.value == ValueNone)
+                return fail(ErrorUnexpectedValue, i);
+            if (!equal && spec.value == ValueRequired)
+                return fail(ErrorMissingValue, i);
+
+            TextView value = equal ? TextView(equal + 1, text.end) : TextView();
+            size_t choice = 0;
+            if (equal && !accepts(spec, value, choice))
+                return fail(ErrorInvalidValue, i);
+
+            m_present[id] = true;
+            m_values[id] = value;
+            m_choices[id] = choice;
+        }
+    }
+
+    size_t m_argc;
+    char** m_argv;
+    const std::vector<std::string>* m_strings;
+
+    bool m_present[OptionCount];
+    TextView m_values[OptionCount];
+    size_t m_choices[OptionCount];
+    Error m_error;
+    size_t m_errorArg;
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// Struct to keep programs
+struct CompilerPrograms
+{
+    std::string cc; // C compiler
+    std::string cxx; // C++ compiler
+    std::string ld; // dynamic libs linker
+    std::string lib; // static libs linker
+    std::string windres; // resource compiler
+};
+
+/// Struct to keep switches
+struct CompilerSwitches
+{
+    std::string includeDirs;   // -I
+    std::string resIncludeDirs;   // --include-dir
+    std::string libDirs;       // -L
+    std::string linkLibs;      // -l
+    std::string libPrefix; // lib
+    std::string libExtension; // a
+    std::string defines;       // -D
+    std::string resDefines;    // --define
+    std::string genericSwitch; // -
+    std::string objectExtension; // o
+    bool forceLinkerUseQuotes; // use quotes for filenames in linker command line (needed or not)?
+    bool forceCompilerUseQuotes; // use quotes for filenames in compiler command line (needed or not)?
+    bool linkerNeedsLibPrefix; // when adding a link library, linker needs prefix?
+    bool linkerNeedsLibExtension; // when adding a link library, linker needs extension?
+    bool supportsPCH; // supports precompiled headers?
+    std::string PCHExtension; // precompiled headers extension
+};
+
+void checkEasyMode(RunContext& ctx, const CmdLineOptions& cl)
+{
+    if (cl.has(OptionEasyMode))
+        ctx.easyMode = cl.enabled(OptionEasyMode);
+}
+
+/// Build profiles of --profile: flags added to those of the configuration, which never
+/// change the ABI (runtime library, defines, exceptions, RTTI, threads, alignment)
+void checkProfile(RunContext& ctx, const CmdLineOptions& cl)
+{
+    if (!cl.has(OptionProfile))
+        return;
+
+    /// in the order of the values of --profile
+    switch (cl.choice(OptionProfile))
+    {
+        case 0:
+            ctx.profile = RunContext::ProfileFastbuild;
+            break;
+        case 1:
+            ctx.profile = RunContext::ProfileOptimized;
+            break;
+        case 2:
+            ctx.profile = RunContext::ProfileOptimized;
+            ctx.pgo = RunContext::PgoInstrument;
+            break;
+        default:
+            ctx.profile = RunContext::ProfileOptimized;
+            ctx.pgo = RunContext::PgoUse;
+            break;
+    }
+}
+
+/// The path made absolute against the current directory, as the tools given it may run
+/// from another one
+std::string absolutePath(const std::string& path)
+{
+#ifdef _WIN32
+    char full[MAX_PATH];
+    DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, full, NULL);
+    return length > 0 && length < MAX_PATH ? std::string(full, length) : path;
+#else
+    if (!path.empty() && path[0] == '/')
+        return path;
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)))
+        return path;
+    std::string relative = path.compare(0, 2, "./") == 0 ? path.substr(2) : path;
+    return relative.empty() || relative == "." ? cwd : std::string(cwd) + "/" + relative;
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Compiler abstract base class
+class Compiler
+{
+public:
+    Compiler(const std::string& name, RunContext& ctx) : m_name(name), m_context(ctx), m_ownPrograms(false) {}
+    // ~Compiler();
+
+    const std::string& easyMode(const std::string& str)
+    {
+        if (m_context.easyMode)
+            return str;
+        else
+            return g_empty;
+    }
+
+    Flag easyMode(const Flag& flag)
+    {
+        if (m_context.easyMode)
+            return flag;
+        else
+            return Flag();
+    }
+
+    /// Flags of the build profile (--profile), added by the process() of each backend: the
+    /// compile ones after the others, the link ones before the libraries. The backends
+    /// hide this one with their own, falling back to it for the profiles they don't have
+    void addProfileFlags(FlagBuilder& /*cflags*/, FlagBuilder& /*libs*/, BuildFileOptions& /*cfg*/)
+    {
+        if (m_context.profile != RunContext::ProfileNone)
+            m_context.messages.push_back(WxConfigMessage(WxConfigMessage::Warning,
+                                                         "The build profile '" + std::string(m_context.profileName()) + "' has no flags for the compiler '" + m_name + "'."));
+    }
+
+    /// True if the flags of build.cfg have the flag, i.e. the wx libraries were built with
+    /// it. The spaces of build.cfg values are dropped when parsed, so it is searched as is
+    bool builtWith(BuildFileOptions& cfg, const char* flag)
+    {
+        return cfg["CPPFLAGS"].find(flag) != std::string::npos || cfg["CXXFLAGS"].find(flag) != std::string::npos ||
+               cfg["LDFLAGS"].find(flag) != std::string::npos;
+    }
+
+    /// Warns, for --profile=optimized, when the static wx libraries were not built for
+    /// link-time optimization, which the toolchains don't report: they are then not
+    /// inlined into the application. There is nothing to inline across a DLL
+    void checkLinkTimeOptimization(BuildFileOptions& cfg, bool wxOptimized, const std::string& compileFlag,
+                                   const std::string& linkFlag)
+    {
+        if (cfg["SHARED"] == "1" || wxOptimized)
+            return;
+
+        m_context.messages.push_back(WxConfigMessage(WxConfigMessage::Warning,
+                                                     "The wx libraries were not built with " + compileFlag + ": they won't be optimized with the application.",
+                                                     "Rebuild wxWidgets with " + compileFlag + " in CXXFLAGS and " + linkFlag + " in LDFLAGS\n"
+                                                     "to optimize across the libraries.\n"));
+    }
+
+    /// The add* helpers make the flags without building them: see Flag
+    Flag addFlag(const std::string& flag)
+    {
+        return Flag(flag);
+    }
+
+    Flag addLib(const std::string& lib)
+    {
+        Flag flag(m_switches.linkLibs, lib, false);
+        if (m_switches.linkerNeedsLibPrefix)
+            flag.prefix = &m_switches.libPrefix;
+        if (m_switches.linkerNeedsLibExtension)
+            flag.extension = &m_switches.libExtension;
+        return flag;
+    }
+
+    Flag addDefine(const std::string& define)
+    {
+        return Flag(m_switches.defines, define, false);
+    }
+
+    Flag addResDefine(const std::string& resDefine)
+    {
+        return Flag(m_switches.resDefines, resDefine, true);
+    }
+
+    Flag addIncludeDir(const std::string& includeDir)
+    {
+        return Flag(m_switches.includeDirs, includeDir, false);
+    }
+
+    Flag addLinkerDir(const std::string& libDir)
+    {
+        return Flag(m_switches.libDirs, libDir, false);
+    }
+
+    Flag addResIncludeDir(const std::string& resIncludeDir)
+    {
+        return Flag(m_switches.resIncludeDirs, resIncludeDir, true);
+    }
+/*
+    std::string addResLinkerDir(const std::string& resLibDir)
     {
         if (resLibDir.empty())
             return "";
         return m_switches.libDirs + libDir + " ";
     }*/
 
+    /// Resolves the naming variables, common to all the compilers
+    void processNames(Options& po, BuildFileOptions& cfg)
+    {
+        // ### Variables: ###
+        po["WX_RELEASE_NODOT"] = cfg["WXVER_MAJOR"] + cfg["WXVER_MINOR"];
+        if (po["WX_RELEASE_NODOT"].empty())
+            po["WX_RELEASE_NODOT"] = "26";
+
+        // ### Conditionally set variables: ###
+        if (cfg["USE_GUI"] == "0")
+            po["PORTNAME"] = "base";
+
+        if (cfg["USE_GUI"] == "1")
+            po["PORTNAME"] = "msw";
+
+        if (cfg["BUILD"] == "debug" && cfg["DEBUG_FLAG"] == "default")
+            po["WXDEBUGFLAG"] = "d";
+
+        if (cfg["DEBUG_FLAG"] == "1")
+            po["WXDEBUGFLAG"] = "d";
+
+        if (cfg["UNICODE"] == "1")
+            po["WXUNICODEFLAG"] = "u";
+
+        if (cfg["WXUNIV"] == "1")
+            po["WXUNIVNAME"] = "univ";
+
+        if (cfg["SHARED"] == "1")
+            po["WXDLLFLAG"] = "dll";
+
+        if (cfg["SHARED"] == "0")
+            po["LIBTYPE_SUFFIX"] = "lib";
+
+        if (cfg["SHARED"] == "1")
+            po["LIBTYPE_SUFFIX"] = "dll";
+
+        if (cfg["MONOLITHIC"] == "0")
+            po["EXTRALIBS_FOR_BASE"] = "";
+
+        if (cfg["MONOLITHIC"] == "1")
+            po["EXTRALIBS_FOR_BASE"] = "";
+    }
+
+    /// Overrides the default programs with the ones used to build wxWidgets, if specified
+    void overridePrograms(BuildFileOptions& cfg)
+    {
+        if (m_ownPrograms)
+            return;
+
+        if (cfg.keyExists("CC"))
+            m_programs.cc = cfg["CC"];
+        
+        if (cfg.keyExists("CXX"))
+            m_programs.cxx = cfg["CXX"];
+
+        if (cfg.keyExists("LD"))
+            m_programs.ld = cfg["LD"];
+
+        if (cfg.keyExists("LIB"))
+            m_programs.lib = cfg["LIB"];
+            
+        if (cfg.keyExists("WINDRES"))
+            m_programs.windres = cfg["WINDRES"];
+    }
+
+    /// Sets the values of the informative queries (--release, --basename, --cc, ...)
+    void setInfoValues(Options& po, BuildFileOptions& cfg)
+    {
+        po["release"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"];
+        po["version"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"] + "." + cfg["WXVER_RELEASE"];
+        po["basename"]  = "wx" + po["PORTNAME"] + po["WXUNIVNAME"] + po["WX_RELEASE_NODOT"];
+        po["basename"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
+        po["cc"] = m_programs.cc;
+        po["cxx"] = m_programs.cxx;
+        po["ld"] = m_programs.ld;
+    }
+
+    /// Resolves only what is needed for the informative queries, without parsing setup.h
+    /// nor building any of the flags
+    void processInfo(Options& po)
+    {
+        /// Searchs for '<prefix>\build\msw\config.*' first
+        BuildFileOptions cfg(m_context, po["prefix"] + PATH_SEP "build" PATH_SEP "msw" PATH_SEP "config." + getName());
+
+        /// build.cfg options
+        cfg.parse(m_context, po["wxcfgfile"]);
+        g_timing.mark("parse build.cfg");
+
+        processNames(po, cfg);
+        overridePrograms(cfg);
+        setInfoValues(po, cfg);
+    }
+
     std::string getName() const
     {
         return m_name;
@@ -543,12 +2694,15 @@ public:
 
     void process_3(Options& po, const CmdLineOptions& cl, BuildFileOptions& cfg)
     {
-        SetupHOptions sho(po["wxcfgsetuphfile"]);
+        TraceSpan span("process_3", "config", po["wxcfg"]);
+        g_timing.mark("process");
+        SetupHOptions sho(m_context, po["wxcfgsetuphfile"]);
+        g_timing.mark("parse setup.h");
         
         // FIXME: proper place of this would be in a first hook, say process_1();
-        if (cl.keyExists("--define-variable"))
+        if (cl.has(OptionDefineVariable))
         {   
-            std::string strDef = cl.keyValue("--define-variable");
+            std::string strDef = cl.value(OptionDefineVariable);
             size_t sep = strDef.find("=");
             if (sep != std::string::npos)
             {
@@ -565,9 +2719,9 @@ public:
             }
             else
             {
-                std::cout << g_tokError << "Failed to define a variable as '" << cl.keyValue("--define-variable") << "'." << std::endl;
-                std::cout << "The syntax is --define-variable=VARIABLENAME=VARIABLEVALUE" << std::endl;
-                exit(1);
+                throw WxConfigException(WxConfigError::InvalidVariable,
+                                        "Failed to define a variable as '" + cl.value(OptionDefineVariable) + "'.\n"
+                                        "The syntax is --define-variable=VARIABLENAME=VARIABLEVALUE");
             }
         }
         
@@ -585,20 +2739,7 @@ public:
         //-------------------------------------------------------------
         
         /// Overriding compiler programs
-        if (cfg.keyExists("CC"))
-            m_programs.cc = cfg["CC"];
-        
-        if (cfg.keyExists("CXX"))
-            m_programs.cxx = cfg["CXX"];
-
-        if (cfg.keyExists("LD"))
-            m_programs.ld = cfg["LD"];
-
-        if (cfg.keyExists("LIB"))
-            m_programs.lib = cfg["LIB"];
-            
-        if (cfg.keyExists("WINDRES"))
-            m_programs.windres = cfg["WINDRES"];
+        overridePrograms(cfg);
 
         //-------------------------------------------------------------
 
@@ -611,9 +2752,11 @@ public:
         po["LIB_BASENAME_BASE"] += po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
 
 
-        for (size_t i=0; i<cl.getLibs().size(); ++i)
+        std::vector<std::string> libNames;
+        cl.getLibs(libNames);
+        for (size_t i=0; i<libNames.size(); ++i)
         {
-            std::string lib = cl.getLibs()[i];
+            const std::string& lib = libNames[i];
 
             if (lib == "base")
             {
@@ -729,6 +2872,7 @@ public:
             {
                 /// Doesn't matter if it's monolithic or not
                 po["__WXLIB_ARGS_p"] += addLib(po["LIB_BASENAME_MSW"] + "_" + lib);
+                m_argLibs.push_back(lib);
             }
         }
 
@@ -841,32 +2985,90 @@ public:
 */     
     }
     
-    std::string getAllLibs(Options& po)
-    {
-        std::string libs;
-        libs += po["__WXLIB_ARGS_p"] + po["__WXLIB_OPENGL_p"] + po["__WXLIB_MEDIA_p"];
-        libs += po["__WXLIB_DBGRID_p"] + po["__WXLIB_ODBC_p"] + po["__WXLIB_XRC_p"];
-        libs += po["__WXLIB_QA_p"] + po["__WXLIB_AUI_p"] + po["__WXLIB_HTML_p"] + po["__WXLIB_ADV_p"];
-        libs += po["__WXLIB_CORE_p"] + po["__WXLIB_XML_p"] + po["__WXLIB_NET_p"];
-        libs += po["__WXLIB_BASE_p"] + po["__WXLIB_MONO_p"];
-        libs += po["__LIB_TIFF_p"] + po["__LIB_JPEG_p"] + po["__LIB_PNG_p"];
-        libs += po["__LIB_ZLIB_p"] + po["__LIB_REGEX_p"] + po["__LIB_EXPAT_p"];
-        libs += po["EXTRALIBS_FOR_BASE"] + po["__UNICOWS_LIB_p"] + po["__GDIPLUS_LIB_p"];
-        libs += po["__LIB_KERNEL32_p"] + po["__LIB_USER32_p"] + po["__LIB_GDI32_p"];
-        libs += po["__LIB_COMDLG32_p"] + po["__LIB_REGEX_p"] + po["__LIB_WINSPOOL_p"];
-        libs += po["__LIB_WINMM_p"] + po["__LIB_SHELL32_p"] + po["__LIB_COMCTL32_p"];
-        libs += po["__LIB_OLE32_p"] + po["__LIB_OLEAUT32_p"] + po["__LIB_UUID_p"];
-        libs += po["__LIB_RPCRT4_p"] + po["__LIB_ADVAPI32_p"] + po["__LIB_WSOCK32_p"];
-        libs += po["__LIB_ODBC32_p"];
-        
-        return libs;
+    /// Appends every resolved library to the linker flags
+    void addAllLibs(FlagBuilder& libs, Options& po)
+    {
+        libs << po["__WXLIB_ARGS_p"] << po["__WXLIB_OPENGL_p"] << po["__WXLIB_MEDIA_p"];
+        libs << po["__WXLIB_DBGRID_p"] << po["__WXLIB_ODBC_p"] << po["__WXLIB_XRC_p"];
+        libs << po["__WXLIB_QA_p"] << po["__WXLIB_AUI_p"] << po["__WXLIB_HTML_p"] << po["__WXLIB_ADV_p"];
+        libs << po["__WXLIB_CORE_p"] << po["__WXLIB_XML_p"] << po["__WXLIB_NET_p"];
+        libs << po["__WXLIB_BASE_p"] << po["__WXLIB_MONO_p"];
+        libs << po["__LIB_TIFF_p"] << po["__LIB_JPEG_p"] << po["__LIB_PNG_p"];
+        libs << po["__LIB_ZLIB_p"] << po["__LIB_REGEX_p"] << po["__LIB_EXPAT_p"];
+        libs << po["EXTRALIBS_FOR_BASE"] << po["__UNICOWS_LIB_p"] << po["__GDIPLUS_LIB_p"];
+        libs << po["__LIB_KERNEL32_p"] << po["__LIB_USER32_p"] << po["__LIB_GDI32_p"];
+        libs << po["__LIB_COMDLG32_p"] << po["__LIB_REGEX_p"] << po["__LIB_WINSPOOL_p"];
+        libs << po["__LIB_WINMM_p"] << po["__LIB_SHELL32_p"] << po["__LIB_COMCTL32_p"];
+        libs << po["__LIB_OLE32_p"] << po["__LIB_OLEAUT32_p"] << po["__LIB_UUID_p"];
+        libs << po["__LIB_RPCRT4_p"] << po["__LIB_ADVAPI32_p"] << po["__LIB_WSOCK32_p"];
+        libs << po["__LIB_ODBC32_p"];
+    }
+
+    /// The DLLs of the wx libraries linked (the __WXLIB_*_p set), in the link order, for a
+    /// SHARED=1 configuration: in LIBDIRNAME, named as the wx makefiles name them, as in
+    /// wxmsw28ud_core_gcc_custom.dll. The development releases (odd minor) have their
+    /// release number in the name too, as in wxmsw293u_core_gcc_custom.dll
+    void getRuntimeDeps(Options& po, const CmdLineOptions& cl, BuildFileOptions& cfg)
+    {
+        if ((!cl.has(OptionRuntimeDeps) && !cl.has(OptionStage)) || cfg["SHARED"] != "1")
+            return;
+
+        std::string version = po["WX_RELEASE_NODOT"];
+        if (atoi(cfg["WXVER_MINOR"].c_str()) % 2 == 1)
+            version += cfg["WXVER_RELEASE"];
+        const std::string flags = po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
+        const std::string gui = "wx" + po["PORTNAME"] + po["WXUNIVNAME"] + version + flags;
+        const std::string base = "wxbase" + version + flags;
+
+        std::string tag = "_" + getName();
+        if (cfg["OFFICIAL_BUILD"] != "1")
+            tag += "_" + cfg["VENDOR"];
+
+        static const struct
+        {
+            const char* key;
+            bool gui;
+            const char* suffix;
+        } libs[] =
+        {
+            { "__WXLIB_OPENGL_p", true, "_gl" }, { "__WXLIB_MEDIA_p", true, "_media" },
+            { "__WXLIB_DBGRID_p", true, "_dbgrid" }, { "__WXLIB_ODBC_p", false, "_odbc" },
+            { "__WXLIB_XRC_p", true, "_xrc" }, { "__WXLIB_QA_p", true, "_qa" },
+            { "__WXLIB_AUI_p", true, "_aui" }, { "__WXLIB_HTML_p", true, "_html" },
+            { "__WXLIB_ADV_p", true, "_adv" }, { "__WXLIB_CORE_p", true, "_core" },
+            { "__WXLIB_XML_p", false, "_xml" }, { "__WXLIB_NET_p", false, "_net" },
+            { "__WXLIB_BASE_p", false, "" }, { "__WXLIB_MONO_p", true, "" }
+        };
+
+        std::vector<std::string> names;
+        for (size_t i = 0; i < m_argLibs.size(); ++i)
+            names.push_back(gui + "_" + m_argLibs[i]);
+        for (size_t i = 0; i < sizeof(libs) / sizeof(libs[0]); ++i)
+            if (po.keyExists(libs[i].key) && !po[libs[i].key].empty())
+                names.push_back((libs[i].gui ? gui : base) + libs[i].suffix);
+
+        const std::string dir = absolutePath(po["LIBDIRNAME"]);
+        std::string missing;
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            std::string dll = dir + PATH_SEP + names[i] + tag + ".dll";
+            if (m_context.files.exists(dll))
+                po["runtime-deps"] += dll + "\n";
+            else
+                missing += "  " + dll + "\n";
+        }
+
+        if (!missing.empty())
+            m_context.messages.push_back(WxConfigMessage(WxConfigMessage::Warning,
+                                                         "Some DLLs of the configuration " + po["wxcfg"] + " haven't been found.",
+                                                         missing + "They are named after the VENDOR and OFFICIAL_BUILD of build.cfg.\n"));
     }
 
     void getVariablesValues(Options& po, const CmdLineOptions& cl, BuildFileOptions& cfg)
     {
-        if (cl.keyExists("--variable"))
+        if (cl.has(OptionVariable))
         {
-            std::string var = cl.keyValue("--variable");
+            std::string var = cl.value(OptionVariable);
             
             if (po.keyExists(var))
                 po["variable"] += "PO: " + var + "=" + po[var] + "\n";
@@ -883,8 +3085,16 @@ public:
 protected:
     // set the following members in your class
     std::string m_name;
+    RunContext& m_context;
     CompilerPrograms m_programs;
     CompilerSwitches m_switches;
+
+    /// The programs aren't the ones which built wxWidgets (clang using a MinGW or VC
+    /// configuration), so the CC, CXX, ... of the configuration don't override them
+    bool m_ownPrograms;
+
+    /// The libraries of the arguments that aren't known ones, as in __WXLIB_ARGS_p
+    std::vector<std::string> m_argLibs;
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -893,13 +3103,22 @@ protected:
 class CompilerMinGW : public Compiler
 {
 public:
-    CompilerMinGW() : Compiler("gcc")
+    CompilerMinGW(RunContext& ctx) : Compiler("gcc", ctx)
     {
+#ifdef _WIN32
         m_programs.cc = "mingw32-gcc";
         m_programs.cxx = "mingw32-g++";
         m_programs.ld = "mingw32-g++ -shared -fPIC -o ";
         m_programs.lib = "ar.exe";
         m_programs.windres = "windres";
+#else
+        /// Cross compiling from a POSIX host
+        m_programs.cc = WXCONFIG_MINGW_PREFIX "gcc";
+        m_programs.cxx = WXCONFIG_MINGW_PREFIX "g++";
+        m_programs.ld = WXCONFIG_MINGW_PREFIX "g++ -shared -fPIC -o ";
+        m_programs.lib = WXCONFIG_MINGW_PREFIX "ar";
+        m_programs.windres = WXCONFIG_MINGW_PREFIX "windres";
+#endif
 
         m_switches.includeDirs = "-I";
         m_switches.resIncludeDirs = "--include-dir";
@@ -918,60 +3137,66 @@ public:
         m_switches.PCHExtension = "h.gch";
     }
 
+    /// fastbuild: no optimization, line tables and function names only as debug info (-g1),
+    /// lld as the linker, and the DLLs not used left out of the imports.
+    /// optimized: link-time optimization, which needs the optimization flags at link time
+    /// too, and the profile-guided optimization phases
+    void addProfileFlags(FlagBuilder& cflags, FlagBuilder& libs, BuildFileOptions& cfg)
+    {
+        if (m_context.profile == RunContext::ProfileFastbuild)
+        {
+            cflags << addFlag("-O0") << addFlag("-g1");
+            libs << addFlag("-fuse-ld=lld") << addFlag("-Wl,--as-needed");
+        }
+        else if (m_context.profile == RunContext::ProfileOptimized)
+        {
+            std::string pgo;
+            if (m_context.pgo == RunContext::PgoInstrument)
+                pgo = addFlag("-fprofile-generate");
+            else if (m_context.pgo == RunContext::PgoUse)
+                FlagBuilder(pgo, 64) << addFlag("-fprofile-use") << addFlag("-fprofile-correction");
+
+            cflags << addFlag("-O2") << addFlag("-flto") << pgo;
+            libs << addFlag("-O2") << addFlag("-flto") << pgo;
+            checkLinkTimeOptimization(cfg, builtWith(cfg, "-flto"), "-flto", "-flto");
+        }
+        else
+            Compiler::addProfileFlags(cflags, libs, cfg);
+    }
+
+    /// Flags only GCC knows, which other drivers would warn about
+    Flag addGccFlag(const std::string& flag)
+    {
+        return addFlag(flag);
+    }
+
     void process(Options& po, const CmdLineOptions& cl)
+    {
+        processWith(*this, po, cl);
+    }
+
+    /// The flags of the MinGW configuration, for the backend driving its compilation: this
+    /// one or another one using the MinGW libraries, which hides the flag hooks it calls
+    template <class Backend>
+    void processWith(Backend& backend, Options& po, const CmdLineOptions& cl)
     {
         /// Searchs for '<prefix>\build\msw\config.*' first
-        std::string cfg_first = po["prefix"] + "\\build\\msw\\config." + getName();
+        std::string cfg_first = po["prefix"] + PATH_SEP "build" PATH_SEP "msw" PATH_SEP "config." + getName();
 
         /// config.* options
-        BuildFileOptions cfg(cfg_first);
+        BuildFileOptions cfg(m_context, cfg_first);
 
         /// build.cfg options
-        cfg.parse(po["wxcfgfile"]);
+        cfg.parse(m_context, po["wxcfgfile"]);
+        g_timing.mark("parse build.cfg");
 
 
-        // ### Variables: ###
-        po["WX_RELEASE_NODOT"] = cfg["WXVER_MAJOR"] + cfg["WXVER_MINOR"];
-        if (po["WX_RELEASE_NODOT"].empty())
-            po["WX_RELEASE_NODOT"] = "26";
+        processNames(po, cfg);
 
         // ### Conditionally set variables: ###
         if (cfg["GCC_VERSION"] == "2.95")
             po["GCCFLAGS"] = addFlag("-fvtable-thunks");
 
-        if (cfg["USE_GUI"] == "0")
-            po["PORTNAME"] = "base";
-
-        if (cfg["USE_GUI"] == "1")
-            po["PORTNAME"] = "msw";
-
-        if (cfg["BUILD"] == "debug" && cfg["DEBUG_FLAG"] == "default")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["DEBUG_FLAG"] == "1")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["UNICODE"] == "1")
-            po["WXUNICODEFLAG"] = "u";
-
-        if (cfg["WXUNIV"] == "1")
-            po["WXUNIVNAME"] = "univ";
-
-        if (cfg["SHARED"] == "1")
-            po["WXDLLFLAG"] = "dll";
-
-        if (cfg["SHARED"] == "0")
-            po["LIBTYPE_SUFFIX"] = "lib";
-
-        if (cfg["SHARED"] == "1")
-            po["LIBTYPE_SUFFIX"] = "dll";
-
-        if (cfg["MONOLITHIC"] == "0")
-            po["EXTRALIBS_FOR_BASE"] = "";
-
-        if (cfg["MONOLITHIC"] == "1")
-            po["EXTRALIBS_FOR_BASE"] = "";
-
         if (cfg["BUILD"] == "debug")
             po["__OPTIMIZEFLAG_2"] = addFlag("-O0");
 
@@ -1071,27 +3296,30 @@ public:
 //----------------------------------------------------
 
         // ### Variables, Part 2: ###
-        po["LIBDIRNAME"] = po["prefix"] + "\\lib\\" + getName() + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
+        po["LIBDIRNAME"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + getName() + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
 
-        po["SETUPHDIR"]  = po["LIBDIRNAME"] + "\\" + po["PORTNAME"] + po["WXUNIVNAME"];
+        po["SETUPHDIR"]  = po["LIBDIRNAME"] + PATH_SEP + po["PORTNAME"] + po["WXUNIVNAME"];
         po["SETUPHDIR"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"];
 
-        po["cflags"]  = easyMode(po["__DEBUGINFO"]) + easyMode(po["__OPTIMIZEFLAG_2"]) + po["__THREADSFLAG"];
-        po["cflags"] += po["GCCFLAGS"] + addDefine("HAVE_W32API_H") + addDefine("__WXMSW__") + po["__WXUNIV_DEFINE_p"];
-        po["cflags"] += po["__DEBUG_DEFINE_p"] + po["__EXCEPTIONS_DEFINE_p"] + po["__RTTI_DEFINE_p"];
-        po["cflags"] += po["__THREAD_DEFINE_p"] + po["__UNICODE_DEFINE_p"] + po["__MSLU_DEFINE_p"];
-        po["cflags"] += po["__GFXCTX_DEFINE_p"];
-        po["cflags"] += addIncludeDir(po["SETUPHDIR"]) + addIncludeDir(po["prefix"] + "\\include");/*-W */
-        po["cflags"] += easyMode(addFlag("-Wall")) + easyMode(addIncludeDir(".")) + po["__DLLFLAG_p"];
-        po["cflags"] += easyMode(addIncludeDir(".\\..\\..\\samples")) + /*addDefine("NOPCH") +*/ po["__RTTIFLAG_5"] + po["__EXCEPTIONSFLAG_6"];
-        po["cflags"] += addFlag("-Wno-ctor-dtor-privacy") + addFlag("-pipe") + addFlag("-fmessage-length=0");
-        po["cflags"] += cfg["CPPFLAGS"] + " " + cfg["CXXFLAGS"] + " ";
-
-        po["libs"]  = cfg["LDFLAGS"] + " ";
-        po["libs"] += easyMode(po["__DEBUGINFO"]) + po["__THREADSFLAG"];
-        po["libs"] += addLinkerDir(po["LIBDIRNAME"]);
-        po["libs"] += easyMode(addFlag("-Wl,--subsystem,windows")) + easyMode(addFlag("-mwindows"));
-        po["libs"] += getAllLibs(po);
+        FlagBuilder cflags(po["cflags"], m_context.cflagArgs);
+        cflags << easyMode(po["__DEBUGINFO"]) << easyMode(po["__OPTIMIZEFLAG_2"]) << po["__THREADSFLAG"];
+        cflags << po["GCCFLAGS"] << addDefine("HAVE_W32API_H") << addDefine("__WXMSW__") << po["__WXUNIV_DEFINE_p"];
+        cflags << po["__DEBUG_DEFINE_p"] << po["__EXCEPTIONS_DEFINE_p"] << po["__RTTI_DEFINE_p"];
+        cflags << po["__THREAD_DEFINE_p"] << po["__UNICODE_DEFINE_p"] << po["__MSLU_DEFINE_p"];
+        cflags << po["__GFXCTX_DEFINE_p"];
+        cflags << addIncludeDir(po["SETUPHDIR"]) << addIncludeDir(po["prefix"] + PATH_SEP "include");/*-W */
+        cflags << easyMode(addFlag("-Wall")) << easyMode(addIncludeDir(".")) << po["__DLLFLAG_p"];
+        cflags << easyMode(addIncludeDir("." PATH_SEP ".." PATH_SEP ".." PATH_SEP "samples")) << /*addDefine("NOPCH") <<*/ po["__RTTIFLAG_5"] << po["__EXCEPTIONSFLAG_6"];
+        cflags << backend.addGccFlag("-Wno-ctor-dtor-privacy") << addFlag("-pipe") << addFlag("-fmessage-length=0");
+        cflags << cfg["CPPFLAGS"] << " " << cfg["CXXFLAGS"] << " ";
+
+        FlagBuilder libs(po["libs"], m_context.libArgs);
+        libs << cfg["LDFLAGS"] << " ";
+        libs << easyMode(po["__DEBUGINFO"]) << po["__THREADSFLAG"];
+        libs << addLinkerDir(po["LIBDIRNAME"]);
+        libs << easyMode(addFlag("-Wl,--subsystem,windows")) << easyMode(addFlag("-mwindows"));
+        backend.addProfileFlags(cflags, libs, cfg);
+        addAllLibs(libs, po);
         
         /*
         po["libs"] += po["__WXLIB_ARGS_p"] + po["__WXLIB_OPENGL_p"] + po["__WXLIB_MEDIA_p"];
@@ -1106,23 +3334,94 @@ public:
         po["libs"] += addLib("winmm") + addLib("shell32") + addLib("comctl32") + addLib("ole32") + addLib("oleaut32");
         po["libs"] += addLib("uuid") + addLib("rpcrt4") + addLib("advapi32") + addLib("wsock32") + addLib("odbc32");
 */
-        po["rcflags"]  = addFlag("--use-temp-file") + addResDefine("__WXMSW__") + po["__WXUNIV_DEFINE_p_1"];
-        po["rcflags"] += po["__DEBUG_DEFINE_p_1"] + po["__EXCEPTIONS_DEFINE_p_1"];
-        po["rcflags"] += po["__RTTI_DEFINE_p_1"] + po["__THREAD_DEFINE_p_1"] + po["__UNICODE_DEFINE_p_1"];
-        po["rcflags"] += po["__MSLU_DEFINE_p_1"] + po["__GFXCTX_DEFINE_p_1"] + addResIncludeDir(po["SETUPHDIR"]);
-        po["rcflags"] += addResIncludeDir(po["prefix"] + "\\include") + easyMode(addResIncludeDir("."));
-        po["rcflags"] += po["__DLLFLAG_p_1"];
-        po["rcflags"] += easyMode(addResIncludeDir(po["prefix"] + "\\samples"));
-
-        po["release"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"];
-        po["version"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"] + "." + cfg["WXVER_RELEASE"];
-        po["basename"]  = "wx" + po["PORTNAME"] + po["WXUNIVNAME"] + po["WX_RELEASE_NODOT"];
-        po["basename"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
-        po["cc"] = m_programs.cc;
-        po["cxx"] = m_programs.cxx;
-        po["ld"] = m_programs.ld;
+        FlagBuilder rcflags(po["rcflags"], m_context.rcflagArgs);
+        rcflags << addFlag("--use-temp-file") << addResDefine("__WXMSW__") << po["__WXUNIV_DEFINE_p_1"];
+        rcflags << po["__DEBUG_DEFINE_p_1"] << po["__EXCEPTIONS_DEFINE_p_1"];
+        rcflags << po["__RTTI_DEFINE_p_1"] << po["__THREAD_DEFINE_p_1"] << po["__UNICODE_DEFINE_p_1"];
+        rcflags << po["__MSLU_DEFINE_p_1"] << po["__GFXCTX_DEFINE_p_1"] << addResIncludeDir(po["SETUPHDIR"]);
+        rcflags << addResIncludeDir(po["prefix"] + PATH_SEP "include") << easyMode(addResIncludeDir("."));
+        rcflags << po["__DLLFLAG_p_1"];
+        rcflags << easyMode(addResIncludeDir(po["prefix"] + PATH_SEP "samples"));
+
+        setInfoValues(po, cfg);
         
         getVariablesValues(po, cl, cfg);
+        getRuntimeDeps(po, cl, cfg);
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// clang with lld, using the libraries of a MinGW configuration (--compiler=clang)
+class CompilerClang : public CompilerMinGW
+{
+public:
+    CompilerClang(RunContext& ctx) : CompilerMinGW(ctx)
+    {
+#ifdef _WIN32
+        m_programs.cc = "clang";
+        m_programs.cxx = "clang++";
+        m_programs.ld = "clang++ -fuse-ld=lld -shared -o ";
+        m_programs.lib = "llvm-ar";
+        m_programs.windres = "llvm-windres";
+#else
+        /// The target prefixed names of llvm-mingw, which imply the target
+        m_programs.cc = WXCONFIG_MINGW_PREFIX "clang";
+        m_programs.cxx = WXCONFIG_MINGW_PREFIX "clang++";
+        m_programs.ld = WXCONFIG_MINGW_PREFIX "clang++ -fuse-ld=lld -shared -o ";
+        m_programs.lib = WXCONFIG_MINGW_PREFIX "ar";
+        m_programs.windres = WXCONFIG_MINGW_PREFIX "windres";
+#endif
+        m_ownPrograms = true;
+    }
+
+    /// lld as the linker, whatever the profile, and on Windows the MinGW target: the LLVM
+    /// builds for Windows target the MSVC ABI by default, not that of the gcc_ libraries.
+    /// fastbuild: no optimization, lld being the fast linker already.
+    /// optimized: ThinLTO, and the profile-guided optimization phases (-fprofile-use reads
+    /// the default.profdata merged by llvm-profdata)
+    void addProfileFlags(FlagBuilder& cflags, FlagBuilder& libs, BuildFileOptions& cfg)
+    {
+        libs << addFlag("-fuse-ld=lld");
+#ifdef _WIN32
+        /// the triple of the cross toolchain prefix, without its trailing '-'
+        std::string target = "--target=" WXCONFIG_MINGW_PREFIX;
+        target.erase(target.size() - 1);
+        cflags << addFlag(target);
+        libs << addFlag(target);
+#endif
+
+        if (m_context.profile == RunContext::ProfileFastbuild)
+            cflags << addFlag("-O0") << addFlag("-g");
+        else if (m_context.profile == RunContext::ProfileOptimized)
+        {
+            std::string pgo;
+            if (m_context.pgo == RunContext::PgoInstrument)
+                pgo = addFlag("-fprofile-generate");
+            else if (m_context.pgo == RunContext::PgoUse)
+                pgo = addFlag("-fprofile-use");
+
+            cflags << addFlag("-O2") << addFlag("-flto=thin") << pgo;
+            libs << addFlag("-O2") << addFlag("-flto=thin") << pgo;
+        }
+        else
+            Compiler::addProfileFlags(cflags, libs, cfg);
+
+        /// GCC's LTO objects only have GIMPLE, unless built with -ffat-lto-objects
+        if (cfg["SHARED"] != "1" && builtWith(cfg, "-flto") && !builtWith(cfg, "-ffat-lto-objects"))
+            m_context.messages.push_back(WxConfigMessage(WxConfigMessage::Warning,
+                                                         "The wx libraries were built with GCC's -flto: lld can't link their objects.",
+                                                         "Rebuild wxWidgets with -ffat-lto-objects in CXXFLAGS, or without -flto.\n"));
+    }
+
+    Flag addGccFlag(const std::string&)
+    {
+        return Flag();
+    }
+
+    void process(Options& po, const CmdLineOptions& cl)
+    {
+        processWith(*this, po, cl);
     }
 };
 
@@ -1132,7 +3431,7 @@ public:
 class CompilerDMC : public Compiler
 {
 public:
-    CompilerDMC() : Compiler("dmc")
+    CompilerDMC(RunContext& ctx) : Compiler("dmc", ctx)
     {
         m_programs.cc = "dmc";
         m_programs.cxx = "dmc";
@@ -1156,56 +3455,29 @@ public:
     }
 
 
+    /// fastbuild: line numbers only as debug info (-gl), no optimization being the default
+    void addProfileFlags(FlagBuilder& cflags, FlagBuilder& libs, BuildFileOptions& cfg)
+    {
+        if (m_context.profile == RunContext::ProfileFastbuild)
+            cflags << addFlag("-gl");
+        else
+            Compiler::addProfileFlags(cflags, libs, cfg);
+    }
+
     void process(Options& po, const CmdLineOptions& cl)
     {
         /// Searchs for '<prefix>\build\msw\config.*' first
-        std::string cfg_first = po["prefix"] + "\\build\\msw\\config." + getName();
+        std::string cfg_first = po["prefix"] + PATH_SEP "build" PATH_SEP "msw" PATH_SEP "config." + getName();
 
         /// config.* options
-        BuildFileOptions cfg(cfg_first);
+        BuildFileOptions cfg(m_context, cfg_first);
 
         /// build.cfg options
-        cfg.parse(po["wxcfgfile"]);
-
-
-        // ### Variables: ###
-        po["WX_RELEASE_NODOT"] = cfg["WXVER_MAJOR"] + cfg["WXVER_MINOR"];
-        if (po["WX_RELEASE_NODOT"].empty())
-            po["WX_RELEASE_NODOT"] = "26";
-
-        // ### Conditionally set variables: ###
-        if (cfg["USE_GUI"] == "0")
-            po["PORTNAME"] = "base";
+        cfg.parse(m_context, po["wxcfgfile"]);
+        g_timing.mark("parse build.cfg");
 
-        if (cfg["USE_GUI"] == "1")
-            po["PORTNAME"] = "msw";
-
-        if (cfg["BUILD"] == "debug" && cfg["DEBUG_FLAG"] == "default")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["DEBUG_FLAG"] == "1")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["UNICODE"] == "1")
-            po["WXUNICODEFLAG"] = "u";
-
-        if (cfg["WXUNIV"] == "1")
-            po["WXUNIVNAME"] = "univ";
-
-        if (cfg["SHARED"] == "1")
-            po["WXDLLFLAG"] = "dll";
-
-        if (cfg["SHARED"] == "0")
-            po["LIBTYPE_SUFFIX"] = "lib";
-
-        if (cfg["SHARED"] == "1")
-            po["LIBTYPE_SUFFIX"] = "dll";
-
-        if (cfg["MONOLITHIC"] == "0")
-            po["EXTRALIBS_FOR_BASE"] = "";
 
-        if (cfg["MONOLITHIC"] == "1")
-            po["EXTRALIBS_FOR_BASE"] = "";
+        processNames(po, cfg);
 
 //----------------------------------------------------
 
@@ -1381,51 +3653,50 @@ public:
 
 
         // ### Variables, Part 2: ###
-        po["LIBDIRNAME"] = po["prefix"] + "\\lib\\" + getName() + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
+        po["LIBDIRNAME"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + getName() + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
 
-        po["SETUPHDIR"]  = po["LIBDIRNAME"] + "\\" + po["PORTNAME"] + po["WXUNIVNAME"];
+        po["SETUPHDIR"]  = po["LIBDIRNAME"] + PATH_SEP + po["PORTNAME"] + po["WXUNIVNAME"];
         po["SETUPHDIR"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"];
 
-        po["cflags"]  = easyMode(po["__DEBUGINFO_0"]) + easyMode(po["__OPTIMIZEFLAG_4"]);
-        po["cflags"] += po["__RUNTIME_LIBS_8"] + " " + addDefine("_WIN32_WINNT=0x0400");
-        po["cflags"] += addDefine("__WXMSW__") + po["__WXUNIV_DEFINE_p"];
-        po["cflags"] += po["__DEBUG_DEFINE_p"] + po["__EXCEPTIONS_DEFINE_p"] + po["__RTTI_DEFINE_p"];
-        po["cflags"] += po["__THREAD_DEFINE_p"] + po["__UNICODE_DEFINE_p"] + po["__MSLU_DEFINE_p"];
-        po["cflags"] += po["__GFXCTX_DEFINE_p"];
-        po["cflags"] += addIncludeDir(po["SETUPHDIR"]) + addIncludeDir(po["prefix"] + "\\include") + easyMode(addFlag("-w-")) + easyMode(addIncludeDir(".")) + po["__DLLFLAG_p"] + easyMode(addFlag("-WA"));
-        po["cflags"] += easyMode(addIncludeDir(po["prefix"] + "\\samples")) + easyMode(addDefine("NOPCH")) + po["__RTTIFLAG_9"] + po["__EXCEPTIONSFLAG_10"];
-        po["cflags"] += cfg["CPPFLAGS"] + " " + cfg["CXXFLAGS"] + " ";
-
-
-
-        po["libs"]  = easyMode(addFlag("/NOLOGO")) + easyMode(addFlag("/SILENT"));
-        po["libs"] += easyMode(addFlag("/NOI")) + easyMode(addFlag("/DELEXECUTABLE"));
-        po["libs"] += easyMode(addFlag("/EXETYPE:NT"));
-        po["libs"] += cfg["LDFLAGS"] + " ";
-        po["libs"] += easyMode(po["__DEBUGINFO_1"]);
-        po["libs"] += addLinkerDir(po["LIBDIRNAME"] + "\\");
-        po["libs"] += easyMode(addFlag("/su:windows:4.0"));
-        po["libs"] += getAllLibs(po);        
-
-        po["rcflags"]  = addResDefine("_WIN32_WINNT=0x0400") + addResDefine("__WXMSW__");
-        po["rcflags"] += po["__WXUNIV_DEFINE_p"] + po["__DEBUG_DEFINE_p"] + po["__EXCEPTIONS_DEFINE_p"];
-        po["rcflags"] += po["__RTTI_DEFINE_p"] + po["__THREAD_DEFINE_p"] + po["__UNICODE_DEFINE_p"];
-        po["rcflags"] += po["__MSLU_DEFINE_p"] + po["__GFXCTX_DEFINE_p"] + addResIncludeDir(po["SETUPHDIR"]);
-        po["rcflags"] += addResIncludeDir(po["prefix"] + "\\include") + easyMode(addResIncludeDir("."));
-        po["rcflags"] += po["__DLLFLAG_p"];
-        po["rcflags"] += easyMode(addResIncludeDir(po["prefix"] + "\\samples"));
-        po["rcflags"] += easyMode(addFlag("-32")) + easyMode(addFlag("-v-"));
-
-
-        po["release"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"];
-        po["version"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"] + "." + cfg["WXVER_RELEASE"];
-        po["basename"]  = "wx" + po["PORTNAME"] + po["WXUNIVNAME"] + po["WX_RELEASE_NODOT"];
-        po["basename"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
-        po["cc"] = m_programs.cc;
-        po["cxx"] = m_programs.cxx;
-        po["ld"] = m_programs.ld;
+        FlagBuilder cflags(po["cflags"], m_context.cflagArgs);
+        cflags << easyMode(po["__DEBUGINFO_0"]) << easyMode(po["__OPTIMIZEFLAG_4"]);
+        cflags << po["__RUNTIME_LIBS_8"] << " " << addDefine("_WIN32_WINNT=0x0400");
+        cflags << addDefine("__WXMSW__") << po["__WXUNIV_DEFINE_p"];
+        cflags << po["__DEBUG_DEFINE_p"] << po["__EXCEPTIONS_DEFINE_p"] << po["__RTTI_DEFINE_p"];
+        cflags << po["__THREAD_DEFINE_p"] << po["__UNICODE_DEFINE_p"] << po["__MSLU_DEFINE_p"];
+        cflags << po["__GFXCTX_DEFINE_p"];
+        cflags << addIncludeDir(po["SETUPHDIR"]) << addIncludeDir(po["prefix"] + PATH_SEP "include") << easyMode(addFlag("-w-")) << easyMode(addIncludeDir(".")) << po["__DLLFLAG_p"] << easyMode(addFlag("-WA"));
+        cflags << easyMode(addIncludeDir(po["prefix"] + PATH_SEP "samples")) << easyMode(addDefine("NOPCH")) << po["__RTTIFLAG_9"] << po["__EXCEPTIONSFLAG_10"];
+        cflags << cfg["CPPFLAGS"] << " " << cfg["CXXFLAGS"] << " ";
+
+
+
+        FlagBuilder libs(po["libs"], m_context.libArgs);
+        libs << easyMode(addFlag("/NOLOGO")) << easyMode(addFlag("/SILENT"));
+        libs << easyMode(addFlag("/NOI")) << easyMode(addFlag("/DELEXECUTABLE"));
+        libs << easyMode(addFlag("/EXETYPE:NT"));
+        libs << cfg["LDFLAGS"] << " ";
+        libs << easyMode(po["__DEBUGINFO_1"]);
+        libs << addLinkerDir(po["LIBDIRNAME"] + PATH_SEP);
+        libs << easyMode(addFlag("/su:windows:4.0"));
+        addProfileFlags(cflags, libs, cfg);
+        addAllLibs(libs, po);
+
+        FlagBuilder rcflags(po["rcflags"], m_context.rcflagArgs);
+        rcflags << addResDefine("_WIN32_WINNT=0x0400") << addResDefine("__WXMSW__");
+        rcflags << po["__WXUNIV_DEFINE_p"] << po["__DEBUG_DEFINE_p"] << po["__EXCEPTIONS_DEFINE_p"];
+        rcflags << po["__RTTI_DEFINE_p"] << po["__THREAD_DEFINE_p"] << po["__UNICODE_DEFINE_p"];
+        rcflags << po["__MSLU_DEFINE_p"] << po["__GFXCTX_DEFINE_p"] << addResIncludeDir(po["SETUPHDIR"]);
+        rcflags << addResIncludeDir(po["prefix"] + PATH_SEP "include") << easyMode(addResIncludeDir("."));
+        rcflags << po["__DLLFLAG_p"];
+        rcflags << easyMode(addResIncludeDir(po["prefix"] + PATH_SEP "samples"));
+        rcflags << easyMode(addFlag("-32")) << easyMode(addFlag("-v-"));
+
+
+        setInfoValues(po, cfg);
         
         getVariablesValues(po, cl, cfg);
+        getRuntimeDeps(po, cl, cfg);
     }
 
 };
@@ -1436,7 +3707,7 @@ public:
 class CompilerVC : public Compiler
 {
 public:
-    CompilerVC() : Compiler("vc")
+    CompilerVC(RunContext& ctx) : Compiler("vc", ctx)
     {
         m_programs.cc = "cl";
         m_programs.cxx = "cl";
@@ -1459,56 +3730,61 @@ public:
         m_switches.linkerNeedsLibExtension = true;
     }
 
+    /// Flags of the compiler driver linking instead of the linker, ahead of the flags of the
+    /// linker: none, link is run directly
+    void addLinkDriverFlags(FlagBuilder& /*libs*/)
+    {
+    }
+
+    /// fastbuild: compiles in parallel (/MP), without optimization, with the debug info in
+    /// the objects (/Z7) instead of a PDB shared by the compilers; links incrementally,
+    /// with a PDB referencing the objects' debug info instead of merging it (/DEBUG:FASTLINK).
+    /// optimized: whole program optimization (/GL and /LTCG), and the profile-guided
+    /// optimization phases
+    void addProfileFlags(FlagBuilder& cflags, FlagBuilder& libs, BuildFileOptions& cfg)
+    {
+        if (m_context.profile == RunContext::ProfileFastbuild)
+        {
+            cflags << addFlag("/MP") << addFlag("/Od") << addFlag("/Z7");
+            libs << addFlag("/INCREMENTAL") << addFlag("/DEBUG:FASTLINK");
+        }
+        else if (m_context.profile == RunContext::ProfileOptimized)
+        {
+            cflags << addFlag("/O2") << addFlag("/GL");
+            if (m_context.pgo == RunContext::PgoInstrument)
+                libs << addFlag("/LTCG:PGINSTRUMENT");
+            else if (m_context.pgo == RunContext::PgoUse)
+                libs << addFlag("/LTCG:PGOPTIMIZE");
+            else
+                libs << addFlag("/LTCG");
+            checkLinkTimeOptimization(cfg, builtWith(cfg, "/GL") || builtWith(cfg, "-GL"), "/GL", "/LTCG");
+        }
+        else
+            Compiler::addProfileFlags(cflags, libs, cfg);
+    }
+
     void process(Options& po, const CmdLineOptions& cl)
+    {
+        processWith(*this, po, cl);
+    }
+
+    /// The flags of the VC configuration, for the backend driving its compilation: this
+    /// one or another one using the VC libraries, which hides the flag hooks it calls
+    template <class Backend>
+    void processWith(Backend& backend, Options& po, const CmdLineOptions& cl)
     {
         /// Searchs for '<prefix>\build\msw\config.*' first
-        std::string cfg_first = po["prefix"] + "\\build\\msw\\config." + getName();
+        std::string cfg_first = po["prefix"] + PATH_SEP "build" PATH_SEP "msw" PATH_SEP "config." + getName();
 
         /// config.* options
-        BuildFileOptions cfg(cfg_first);
+        BuildFileOptions cfg(m_context, cfg_first);
 
         /// build.cfg options
-        cfg.parse(po["wxcfgfile"]);
-
-
-        // ### Variables: ###
-        po["WX_RELEASE_NODOT"] = cfg["WXVER_MAJOR"] + cfg["WXVER_MINOR"];
-        if (po["WX_RELEASE_NODOT"].empty())
-            po["WX_RELEASE_NODOT"] = "26";
-
-        // ### Conditionally set variables: ###
-        if (cfg["USE_GUI"] == "0")
-            po["PORTNAME"] = "base";
-
-        if (cfg["USE_GUI"] == "1")
-            po["PORTNAME"] = "msw";
-
-        if (cfg["BUILD"] == "debug" && cfg["DEBUG_FLAG"] == "default")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["DEBUG_FLAG"] == "1")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["UNICODE"] == "1")
-            po["WXUNICODEFLAG"] = "u";
-
-        if (cfg["WXUNIV"] == "1")
-            po["WXUNIVNAME"] = "univ";
-
-        if (cfg["SHARED"] == "1")
-            po["WXDLLFLAG"] = "dll";
-
-        if (cfg["SHARED"] == "0")
-            po["LIBTYPE_SUFFIX"] = "lib";
-
-        if (cfg["SHARED"] == "1")
-            po["LIBTYPE_SUFFIX"] = "dll";
+        cfg.parse(m_context, po["wxcfgfile"]);
+        g_timing.mark("parse build.cfg");
 
-        if (cfg["MONOLITHIC"] == "0")
-            po["EXTRALIBS_FOR_BASE"] = "";
 
-        if (cfg["MONOLITHIC"] == "1")
-            po["EXTRALIBS_FOR_BASE"] = "";
+        processNames(po, cfg);
 
         if (cfg["TARGET_CPU"] == "amd64")
             po["DIR_SUFFIX_CPU"] = "_amd64";
@@ -1700,45 +3976,111 @@ public:
 
 
         // ### Variables, Part 2: ###
-        po["LIBDIRNAME"] = po["prefix"] + "\\lib\\" + getName() + po["DIR_SUFFIX_CPU"] + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
+        po["LIBDIRNAME"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + getName() + po["DIR_SUFFIX_CPU"] + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
 
-        po["SETUPHDIR"]  = po["LIBDIRNAME"] + "\\" + po["PORTNAME"] + po["WXUNIVNAME"];
+        po["SETUPHDIR"]  = po["LIBDIRNAME"] + PATH_SEP + po["PORTNAME"] + po["WXUNIVNAME"];
         po["SETUPHDIR"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"];
 
-        po["cflags"]  = "/M" + po["__RUNTIME_LIBS_8"] + po["__DEBUGRUNTIME_3"] + " " + addDefine("WIN32");
-        po["cflags"] += easyMode(po["__DEBUGINFO_0"]) + easyMode(po["____DEBUGRUNTIME_2_p"]);
-        po["cflags"] += easyMode(po["__OPTIMIZEFLAG_4"]) + po["__NO_VC_CRTDBG_p"] + addDefine("__WXMSW__") + po["__WXUNIV_DEFINE_p"];
-        po["cflags"] += po["__DEBUG_DEFINE_p"] + po["__EXCEPTIONS_DEFINE_p"] + po["__RTTI_DEFINE_p"];
-        po["cflags"] += po["__THREAD_DEFINE_p"] + po["__UNICODE_DEFINE_p"] + po["__MSLU_DEFINE_p"] + po["__GFXCTX_DEFINE_p"];
-        po["cflags"] += addIncludeDir(po["SETUPHDIR"]) + addIncludeDir(po["prefix"] + "\\include") + easyMode(addFlag("/W4")) + easyMode(addIncludeDir(".")) + po["__DLLFLAG_p"] + addDefine("_WINDOWS");
-        po["cflags"] += easyMode(addIncludeDir(po["prefix"] + "\\samples")) + easyMode(addDefine("NOPCH")) + po["__RTTIFLAG_9"] + po["__EXCEPTIONSFLAG_10"];
-        po["cflags"] += cfg["CPPFLAGS"] + " " + cfg["CXXFLAGS"] + " ";
-
-        po["libs"]  = easyMode(addFlag("/NOLOGO"));
-        po["libs"] += cfg["LDFLAGS"] + " ";
-        po["libs"] += easyMode(po["__DEBUGINFO_1"]) + " " + po["LINK_TARGET_CPU"] + " ";
-        po["libs"] += addLinkerDir(po["LIBDIRNAME"]);
-        po["libs"] += easyMode(addFlag("/SUBSYSTEM:WINDOWS"));
-        po["libs"] += getAllLibs(po);
-
-        po["rcflags"]  = addResDefine("WIN32") + po["____DEBUGRUNTIME_2_p_1"] + po["__NO_VC_CRTDBG_p_1"] + addResDefine("__WXMSW__");
-        po["rcflags"] += po["__WXUNIV_DEFINE_p_1"] + po["__DEBUG_DEFINE_p_1"] + po["__EXCEPTIONS_DEFINE_p_1"];
-        po["rcflags"] += po["__RTTI_DEFINE_p_1"] + po["__THREAD_DEFINE_p_1"] + po["__UNICODE_DEFINE_p_1"];
-        po["rcflags"] += po["__MSLU_DEFINE_p_1"] + po["__GFXCTX_DEFINE_p_1"] + addResIncludeDir(po["SETUPHDIR"]);
-        po["rcflags"] += addResIncludeDir(po["prefix"] + "\\include") + easyMode(addResIncludeDir("."));
-        po["rcflags"] += po["__DLLFLAG_p_1"] + addResDefine("_WINDOWS");
-        po["rcflags"] += easyMode(addResIncludeDir(po["prefix"] + "\\samples"));
-
-
-        po["release"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"];
-        po["version"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"] + "." + cfg["WXVER_RELEASE"];
-        po["basename"]  = "wx" + po["PORTNAME"] + po["WXUNIVNAME"] + po["WX_RELEASE_NODOT"];
-        po["basename"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
-        po["cc"] = m_programs.cc;
-        po["cxx"] = m_programs.cxx;
-        po["ld"] = m_programs.ld;
+        FlagBuilder cflags(po["cflags"], m_context.cflagArgs);
+        cflags << "/M" << po["__RUNTIME_LIBS_8"] << po["__DEBUGRUNTIME_3"] << " " << addDefine("WIN32");
+        cflags << easyMode(po["__DEBUGINFO_0"]) << easyMode(po["____DEBUGRUNTIME_2_p"]);
+        cflags << easyMode(po["__OPTIMIZEFLAG_4"]) << po["__NO_VC_CRTDBG_p"] << addDefine("__WXMSW__") << po["__WXUNIV_DEFINE_p"];
+        cflags << po["__DEBUG_DEFINE_p"] << po["__EXCEPTIONS_DEFINE_p"] << po["__RTTI_DEFINE_p"];
+        cflags << po["__THREAD_DEFINE_p"] << po["__UNICODE_DEFINE_p"] << po["__MSLU_DEFINE_p"] << po["__GFXCTX_DEFINE_p"];
+        cflags << addIncludeDir(po["SETUPHDIR"]) << addIncludeDir(po["prefix"] + PATH_SEP "include") << easyMode(addFlag("/W4")) << easyMode(addIncludeDir(".")) << po["__DLLFLAG_p"] << addDefine("_WINDOWS");
+        cflags << easyMode(addIncludeDir(po["prefix"] + PATH_SEP "samples")) << easyMode(addDefine("NOPCH")) << po["__RTTIFLAG_9"] << po["__EXCEPTIONSFLAG_10"];
+        cflags << cfg["CPPFLAGS"] << " " << cfg["CXXFLAGS"] << " ";
+
+        FlagBuilder libs(po["libs"], m_context.libArgs);
+        backend.addLinkDriverFlags(libs);
+        libs << easyMode(addFlag("/NOLOGO"));
+        libs << cfg["LDFLAGS"] << " ";
+        libs << easyMode(po["__DEBUGINFO_1"]) << " " << po["LINK_TARGET_CPU"] << " ";
+        libs << addLinkerDir(po["LIBDIRNAME"]);
+        libs << easyMode(addFlag("/SUBSYSTEM:WINDOWS"));
+        backend.addProfileFlags(cflags, libs, cfg);
+        addAllLibs(libs, po);
+
+        FlagBuilder rcflags(po["rcflags"], m_context.rcflagArgs);
+        rcflags << addResDefine("WIN32") << po["____DEBUGRUNTIME_2_p_1"] << po["__NO_VC_CRTDBG_p_1"] << addResDefine("__WXMSW__");
+        rcflags << po["__WXUNIV_DEFINE_p_1"] << po["__DEBUG_DEFINE_p_1"] << po["__EXCEPTIONS_DEFINE_p_1"];
+        rcflags << po["__RTTI_DEFINE_p_1"] << po["__THREAD_DEFINE_p_1"] << po["__UNICODE_DEFINE_p_1"];
+        rcflags << po["__MSLU_DEFINE_p_1"] << po["__GFXCTX_DEFINE_p_1"] << addResIncludeDir(po["SETUPHDIR"]);
+        rcflags << addResIncludeDir(po["prefix"] + PATH_SEP "include") << easyMode(addResIncludeDir("."));
+        rcflags << po["__DLLFLAG_p_1"] << addResDefine("_WINDOWS");
+        rcflags << easyMode(addResIncludeDir(po["prefix"] + PATH_SEP "samples"));
+
+
+        setInfoValues(po, cfg);
         
         getVariablesValues(po, cl, cfg);
+        getRuntimeDeps(po, cl, cfg);
+    }
+};
+
+// -------------------------------------------------------------------------------------------------
+
+/// clang-cl with lld-link, using the libraries of a VC configuration (--compiler=clang-cl).
+/// clang-cl takes the cl flags, and lld-link the link ones
+class CompilerClangCL : public CompilerVC
+{
+public:
+    CompilerClangCL(RunContext& ctx) : CompilerVC(ctx)
+    {
+        m_programs.cc = "clang-cl";
+        m_programs.cxx = "clang-cl";
+        m_programs.ld = linksThroughDriver() ? "clang-cl -fuse-ld=lld" : "lld-link";
+        m_programs.lib = "llvm-lib";
+        m_programs.windres = "llvm-rc";
+        m_ownPrograms = true;
+    }
+
+    /// The instrumented program is linked by clang-cl, which adds the profiling runtime of
+    /// the target from its own directory; lld-link alone knows neither
+    bool linksThroughDriver() const
+    {
+        return m_context.profile == RunContext::ProfileOptimized && m_context.pgo == RunContext::PgoInstrument;
+    }
+
+    /// The flags of the linker then follow /link
+    void addLinkDriverFlags(FlagBuilder& libs)
+    {
+        if (linksThroughDriver())
+            libs << addFlag("-fprofile-instr-generate") << addFlag("/link");
+    }
+
+    /// fastbuild: no optimization, the debug info in the objects with precomputed type
+    /// hashes, which lld-link merges into the PDB without hashing them again (/DEBUG:GHASH).
+    /// optimized: ThinLTO, lld-link optimizing the bitcode objects it is given, and the
+    /// profile-guided optimization phases (-fprofile-instr-use reads default.profdata)
+    void addProfileFlags(FlagBuilder& cflags, FlagBuilder& libs, BuildFileOptions& cfg)
+    {
+        if (m_context.profile == RunContext::ProfileFastbuild)
+        {
+            cflags << addFlag("/Od") << addFlag("/Z7") << addFlag("-gcodeview-ghash");
+            libs << addFlag("/DEBUG:GHASH");
+        }
+        else if (m_context.profile == RunContext::ProfileOptimized)
+        {
+            cflags << addFlag("/O2") << addFlag("-flto=thin");
+            if (m_context.pgo == RunContext::PgoInstrument)
+                cflags << addFlag("-fprofile-instr-generate");
+            else if (m_context.pgo == RunContext::PgoUse)
+                cflags << addFlag("-fprofile-instr-use");
+        }
+        else
+            Compiler::addProfileFlags(cflags, libs, cfg);
+
+        /// The objects compiled with /GL are in a format of VC only
+        if (cfg["SHARED"] != "1" && (builtWith(cfg, "/GL") || builtWith(cfg, "-GL")))
+            m_context.messages.push_back(WxConfigMessage(WxConfigMessage::Warning,
+                                                         "The wx libraries were built with /GL: lld-link can't link their objects.",
+                                                         "Rebuild wxWidgets without /GL, or with clang-cl and -flto=thin.\n"));
+    }
+
+    void process(Options& po, const CmdLineOptions& cl)
+    {
+        processWith(*this, po, cl);
     }
 };
 
@@ -1748,7 +4090,7 @@ public:
 class CompilerWAT : public Compiler
 {
 public:
-    CompilerWAT() : Compiler("wat")
+    CompilerWAT(RunContext& ctx) : Compiler("wat", ctx)
     {
         m_programs.cc = "wcl386";//TODO: wcc386
         m_programs.cxx = "wcl386";//TODO: wpp386
@@ -1771,56 +4113,29 @@ public:
         m_switches.linkerNeedsLibExtension = true;
     }
 
+    /// fastbuild: line numbers only as debug info (-d1), without optimization (-od)
+    void addProfileFlags(FlagBuilder& cflags, FlagBuilder& libs, BuildFileOptions& cfg)
+    {
+        if (m_context.profile == RunContext::ProfileFastbuild)
+            cflags << addFlag("-d1") << addFlag("-od");
+        else
+            Compiler::addProfileFlags(cflags, libs, cfg);
+    }
+
     void process(Options& po, const CmdLineOptions& cl)
     {
         /// Searchs for '<prefix>\build\msw\config.*' first
-        std::string cfg_first = po["prefix"] + "\\build\\msw\\config." + getName();
-
-        /// config.* options
-        BuildFileOptions cfg(cfg_first);
+        std::string cfg_first = po["prefix"] + PATH_SEP "build" PATH_SEP "msw" PATH_SEP "config." + getName();
 
-        /// build.cfg options
-        cfg.parse(po["wxcfgfile"]);
-
-
-        // ### Variables: ###
-        po["WX_RELEASE_NODOT"] = cfg["WXVER_MAJOR"] + cfg["WXVER_MINOR"];
-        if (po["WX_RELEASE_NODOT"].empty())
-            po["WX_RELEASE_NODOT"] = "26";
-
-        // ### Conditionally set variables: ###
-        if (cfg["USE_GUI"] == "0")
-            po["PORTNAME"] = "base";
-
-        if (cfg["USE_GUI"] == "1")
-            po["PORTNAME"] = "msw";
-
-        if (cfg["BUILD"] == "debug" && cfg["DEBUG_FLAG"] == "default")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["DEBUG_FLAG"] == "1")
-            po["WXDEBUGFLAG"] = "d";
-
-        if (cfg["UNICODE"] == "1")
-            po["WXUNICODEFLAG"] = "u";
-
-        if (cfg["WXUNIV"] == "1")
-            po["WXUNIVNAME"] = "univ";
-
-        if (cfg["SHARED"] == "1")
-            po["WXDLLFLAG"] = "dll";
-
-        if (cfg["SHARED"] == "0")
-            po["LIBTYPE_SUFFIX"] = "lib";
+        /// config.* options
+        BuildFileOptions cfg(m_context, cfg_first);
 
-        if (cfg["SHARED"] == "1")
-            po["LIBTYPE_SUFFIX"] = "dll";
+        /// build.cfg options
+        cfg.parse(m_context, po["wxcfgfile"]);
+        g_timing.mark("parse build.cfg");
 
-        if (cfg["MONOLITHIC"] == "0")
-            po["EXTRALIBS_FOR_BASE"] = "";
 
-        if (cfg["MONOLITHIC"] == "1")
-            po["EXTRALIBS_FOR_BASE"] = "";
+        processNames(po, cfg);
 //---------till here, the same
         if (cfg["BUILD"] == "debug" && cfg["DEBUG_INFO"] == "default")
             po["__DEBUGINFO_0"] = addFlag("-d2");
@@ -1911,48 +4226,47 @@ public:
 
 
         // ### Variables, Part 2: ###
-        po["LIBDIRNAME"] = po["prefix"] + "\\lib\\" + getName() + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
+        po["LIBDIRNAME"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + getName() + "_" + po["LIBTYPE_SUFFIX"] + cfg["CFG"];
 
-        po["SETUPHDIR"]  = po["LIBDIRNAME"] + "\\" + po["PORTNAME"] + po["WXUNIVNAME"];
+        po["SETUPHDIR"]  = po["LIBDIRNAME"] + PATH_SEP + po["PORTNAME"] + po["WXUNIVNAME"];
         po["SETUPHDIR"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"];
 
-        po["cflags"]  = easyMode(po["__DEBUGINFO_0"]) + easyMode(po["__OPTIMIZEFLAG_2"]) + po["__THREADSFLAG_5"];
-        po["cflags"] += po["__RUNTIME_LIBS_6"] + addDefine("__WXMSW__") + po["__WXUNIV_DEFINE_p"];
-        po["cflags"] += po["__DEBUG_DEFINE_p"] + po["__EXCEPTIONS_DEFINE_p"] + po["__RTTI_DEFINE_p"];
-        po["cflags"] += po["__THREAD_DEFINE_p"] + po["__UNICODE_DEFINE_p"] + po["__MSLU_DEFINE_p"] + po["__GFXCTX_DEFINE_p"];
-        po["cflags"] += addIncludeDir(po["SETUPHDIR"]) + addIncludeDir(po["prefix"] + "\\include");
-        po["cflags"] += addFlag("-wx") + addFlag("-wcd=549") + addFlag("-wcd=656") + addFlag("-wcd=657") + addFlag("-wcd=667");
-        po["cflags"] += easyMode(addIncludeDir(".")) + po["__DLLFLAG_p"];
-        po["cflags"] += easyMode(addIncludeDir(po["prefix"] + "\\samples")) + addDefine("NOPCH") + po["__RTTIFLAG_7"] + po["__EXCEPTIONSFLAG_8"];
-        po["cflags"] += cfg["CPPFLAGS"] + " " + cfg["CXXFLAGS"] + " ";
+        FlagBuilder cflags(po["cflags"], m_context.cflagArgs);
+        cflags << easyMode(po["__DEBUGINFO_0"]) << easyMode(po["__OPTIMIZEFLAG_2"]) << po["__THREADSFLAG_5"];
+        cflags << po["__RUNTIME_LIBS_6"] << addDefine("__WXMSW__") << po["__WXUNIV_DEFINE_p"];
+        cflags << po["__DEBUG_DEFINE_p"] << po["__EXCEPTIONS_DEFINE_p"] << po["__RTTI_DEFINE_p"];
+        cflags << po["__THREAD_DEFINE_p"] << po["__UNICODE_DEFINE_p"] << po["__MSLU_DEFINE_p"] << po["__GFXCTX_DEFINE_p"];
+        cflags << addIncludeDir(po["SETUPHDIR"]) << addIncludeDir(po["prefix"] + PATH_SEP "include");
+        cflags << addFlag("-wx") << addFlag("-wcd=549") << addFlag("-wcd=656") << addFlag("-wcd=657") << addFlag("-wcd=667");
+        cflags << easyMode(addIncludeDir(".")) << po["__DLLFLAG_p"];
+        cflags << easyMode(addIncludeDir(po["prefix"] + PATH_SEP "samples")) << addDefine("NOPCH") << po["__RTTIFLAG_7"] << po["__EXCEPTIONSFLAG_8"];
+        cflags << cfg["CPPFLAGS"] << " " << cfg["CXXFLAGS"] << " ";
 
         po["lbc"]  = "option quiet\n";
         po["lbc"] += "name $^@\n";
         po["lbc"] += "option caseexact\n";
-        po["libs"]  = cfg["LDFLAGS"] + " ";
-        po["libs"] += easyMode(po["__DEBUGINFO_1"]);
-        po["libs"] += addLinkerDir(po["LIBDIRNAME"]);
+        FlagBuilder libs(po["libs"], m_context.libArgs);
+        libs << cfg["LDFLAGS"] << " ";
+        libs << easyMode(po["__DEBUGINFO_1"]);
+        libs << addLinkerDir(po["LIBDIRNAME"]);
         po["lbc"] += "    libpath " + po["LIBDIRNAME"] + " system nt_win ref '_WinMain@16'";
-        po["libs"] += getAllLibs(po);
-
-        po["rcflags"]  = addFlag("-q") + addFlag("-ad") + addFlag("-bt=nt") + addFlag("-r");
-        po["rcflags"] += addResDefine("__WXMSW__") + po["__WXUNIV_DEFINE_p"];
-        po["rcflags"] += po["__DEBUG_DEFINE_p"] + po["__EXCEPTIONS_DEFINE_p"];
-        po["rcflags"] += po["__RTTI_DEFINE_p"] + po["__THREAD_DEFINE_p"] + po["__UNICODE_DEFINE_p"];
-        po["rcflags"] += po["__MSLU_DEFINE_p"] + po["__GFXCTX_DEFINE_p"] + addResIncludeDir(po["SETUPHDIR"]);
-        po["rcflags"] += addResIncludeDir(po["prefix"] + "\\include") + easyMode(addResIncludeDir("."));
-        po["rcflags"] += po["__DLLFLAG_p_1"];
-        po["rcflags"] += easyMode(addResIncludeDir(po["prefix"] + "\\samples"));
-
-        po["release"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"];
-        po["version"] = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"] + "." + cfg["WXVER_RELEASE"];
-        po["basename"]  = "wx" + po["PORTNAME"] + po["WXUNIVNAME"] + po["WX_RELEASE_NODOT"];
-        po["basename"] += po["WXUNICODEFLAG"] + po["WXDEBUGFLAG"] + cfg["WX_LIB_FLAVOUR"];
-        po["cc"] = m_programs.cc;
-        po["cxx"] = m_programs.cxx;
-        po["ld"] = m_programs.ld;
+        addProfileFlags(cflags, libs, cfg);
+        addAllLibs(libs, po);
+
+        FlagBuilder rcflags(po["rcflags"], m_context.rcflagArgs);
+        rcflags << addFlag("-q") << addFlag("-ad") << addFlag("-bt=nt") << addFlag("-r");
+        rcflags << addResDefine("__WXMSW__") << po["__WXUNIV_DEFINE_p"];
+        rcflags << po["__DEBUG_DEFINE_p"] << po["__EXCEPTIONS_DEFINE_p"];
+        rcflags << po["__RTTI_DEFINE_p"] << po["__THREAD_DEFINE_p"] << po["__UNICODE_DEFINE_p"];
+        rcflags << po["__MSLU_DEFINE_p"] << po["__GFXCTX_DEFINE_p"] << addResIncludeDir(po["SETUPHDIR"]);
+        rcflags << addResIncludeDir(po["prefix"] + PATH_SEP "include") << easyMode(addResIncludeDir("."));
+        rcflags << po["__DLLFLAG_p_1"];
+        rcflags << easyMode(addResIncludeDir(po["prefix"] + PATH_SEP "samples"));
+
+        setInfoValues(po, cfg);
         
         getVariablesValues(po, cl, cfg);
+        getRuntimeDeps(po, cl, cfg);
     }
 };
 
@@ -1962,7 +4276,7 @@ public:
 class CompilerBCC : public Compiler
 {
 public:
-    CompilerBCC() : Compiler("bcc")
+    CompilerBCC(RunContext& ctx) : Compiler("bcc", ctx)
     {
         m_programs.cc = "bcc32";
         m_programs.cxx = "bcc32";
@@ -1985,25 +4299,39 @@ public:
         m_switches.linkerNeedsLibExtension = true;
     }
 
-    void process(Options& po, const CmdLineOptions& cl) {}
+    void process(Options& /*po*/, const CmdLineOptions& /*cl*/) {}
+    void processInfo(Options& /*po*/) {}
 };
 
 // -------------------------------------------------------------------------------------------------
 
-void normalizePath(std::string& path)
+/// Converts all the slashes and backslashes to the native separator, and removes the
+/// trailing one. The leading one is removed too, unless the path is absolute (keepRoot).
+/// On Windows, only a UNC path (\\server\share) keeps it: a prefix like \wxWidgets has
+/// always been taken as relative to the current directory there
+void normalizePath(std::string& path, bool keepRoot = false)
 {
-    // converts all slashes to backslashes
-    std::replace(path.begin(), path.end(), '/', '\\');
+    if (path.empty())
+        return;
+
+    const char sep = PATH_SEP[0];
+    std::replace(path.begin(), path.end(), sep == '/' ? '\\' : '/', sep);
+#ifdef _WIN32
+    keepRoot = keepRoot && path.length() > 1 && path[1] == sep;
+#endif
 
     // removes the first slash (if any) from the given path
     std::string::iterator firstChar = path.begin();
-    if (*firstChar == '\\')
+    if (*firstChar == sep && !keepRoot)
         path.erase(firstChar);
 
     // removes the last slash (if any) from the given path
-    std::string::iterator lastChar = path.end() - 1;
-    if (*lastChar == '\\')
-        path.erase(lastChar);
+    if (path.length() > 1)
+    {
+        std::string::iterator lastChar = path.end() - 1;
+        if (*lastChar == sep)
+            path.erase(lastChar);
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -2172,27 +4500,26 @@ bool replaceStatic(std::string& wxcfg, bool enable)
 
 // -------------------------------------------------------------------------------------------------
 
-void autodetectConfiguration(Options& po, const CmdLineOptions& cl)
+/// The configurations the autodetection probes, in order: the one given, then its
+/// variations by the options the user didn't supply
+void configurationCandidates(const std::string& wxcfg, const CmdLineOptions& cl, std::vector<std::string>& cfgs)
 {
-    // TODO: still directory listing is needed, to account for $(CFG), $(DIR_SUFFIX_CPU), ...
-    
-    std::vector<std::string> cfgs;
     std::vector<std::string> newCfgs;
     std::string              cfg;
     std::vector<std::string>::iterator curCfg;
 
     // Iterate through the options the user didn't supply
-	cfgs.push_back(po["wxcfg"]);
-    if (!cl.keyExists("--universal"))
+    cfgs.push_back(wxcfg);
+    if (!cl.has(OptionUniversal))
     {
-        cfg = po["wxcfg"];
+        cfg = wxcfg;
         if (replaceUniv(cfg, true))
             cfgs.push_back(cfg);
-        cfg = po["wxcfg"];
+        cfg = wxcfg;
         if (replaceUniv(cfg, false))
             cfgs.push_back(cfg);
     }
-    if (!cl.keyExists("--unicode"))
+    if (!cl.has(OptionUnicode))
     {
         newCfgs.clear();
         for (curCfg = cfgs.begin(); curCfg != cfgs.end(); ++curCfg)
@@ -2207,7 +4534,7 @@ void autodetectConfiguration(Options& po, const CmdLineOptions& cl)
         for (curCfg = newCfgs.begin(); curCfg != newCfgs.end(); ++curCfg)
            cfgs.push_back(*curCfg);
     }
-    if (!cl.keyExists("--debug"))
+    if (!cl.has(OptionDebug))
     {
         newCfgs.clear();
         for (curCfg = cfgs.begin(); curCfg != cfgs.end(); ++curCfg)
@@ -2222,7 +4549,7 @@ void autodetectConfiguration(Options& po, const CmdLineOptions& cl)
         for (curCfg = newCfgs.begin(); curCfg != newCfgs.end(); ++curCfg)
            cfgs.push_back(*curCfg);
     }
-    if (!cl.keyExists("--static"))
+    if (!cl.has(OptionStatic))
     {
         newCfgs.clear();
         for (curCfg = cfgs.begin(); curCfg != cfgs.end(); ++curCfg)
@@ -2237,7 +4564,7 @@ void autodetectConfiguration(Options& po, const CmdLineOptions& cl)
         for (curCfg = newCfgs.begin(); curCfg != newCfgs.end(); ++curCfg)
            cfgs.push_back(*curCfg);
     }
-    if (!cl.keyExists("--compiler"))
+    if (!cl.has(OptionCompiler))
     {
        newCfgs.clear();
        for (curCfg = cfgs.begin(); curCfg != cfgs.end(); ++curCfg)
@@ -2261,284 +4588,1144 @@ void autodetectConfiguration(Options& po, const CmdLineOptions& cl)
        for (curCfg = newCfgs.begin(); curCfg != newCfgs.end(); ++curCfg)
           cfgs.push_back(*curCfg);
     }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+void autodetectConfiguration(RunContext& ctx, Options& po, const CmdLineOptions& cl)
+{
+    // TODO: still directory listing is needed, to account for $(CFG), $(DIR_SUFFIX_CPU), ...
+    TraceSpan span("autodetect", "config", po["wxcfg"]);
+    
+    std::vector<std::string> cfgs;
+    configurationCandidates(po["wxcfg"], cl, cfgs);
+
+
+    if (g_stats.enabled)
+    {
+        g_stats.candidates += cfgs.size();
+        std::vector<std::string> distinct(cfgs);
+        std::sort(distinct.begin(), distinct.end());
+        g_stats.distinctCandidates += std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+    }
+
+    if (ctx.prefetch == RunContext::PrefetchAlways)
+    {
+        std::vector<std::string> probes;
+        for (std::vector<std::string>::const_iterator it = cfgs.begin(); it != cfgs.end(); ++it)
+            probes.push_back(po["prefix"] + PATH_SEP "lib" PATH_SEP + *it + PATH_SEP "wx" PATH_SEP "setup.h");
+        ctx.files.prefetch(std::vector<std::string>(), probes);
+    }
+
+    // reads the first setup.h it founds
+    bool found = false;
+    for(std::vector<std::string>::const_iterator it = cfgs.begin(); it != cfgs.end(); ++it)
+    {
+        std::string file = po["prefix"] + PATH_SEP "lib" PATH_SEP + *it + PATH_SEP "wx" PATH_SEP "setup.h";
+        g_trace.begin("probe", "file", file);
+        bool exists = ctx.files.exists(file);
+        g_trace.end();
+        if (exists)
+        {
+            if (!found)
+            {
+                po["wxcfg"] = *it;
+                found = true;
+            }
+            else
+            {
+                ctx.messages.push_back(WxConfigMessage(WxConfigMessage::Warning,
+                                                       "Multiple compiled configurations of wxWidgets have been detected.",
+                                                       "Using first detected version by default.\n\n" + g_hintWxcfg));
+                return;
+            }
+        }
+    }
+
+    if (!po.keyExists("wxcfg"))
+    {
+        // TODO: this never reaches thanks to the new autodetection algorithm
+
+        throw WxConfigException(WxConfigError::NoConfigurationDetected,
+                                "No setup.h file has been auto-detected.", "\n" + g_hintWxcfg);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+void checkAdditionalFlags(Options& po, const CmdLineOptions& cl)
+{
+    /// Modifies wxcfg as 'vc[cpu]_[dll|lib][CFG]\[msw|base][univ][u][d]' accordingly
+    /// or 'gcc_[dll|lib][CFG]\[msw|base][univ][u][d]'
+
+    if (cl.has(OptionUniversal))
+        replaceUniv(po["wxcfg"], cl.enabled(OptionUniversal));
+
+    if (cl.has(OptionUnicode))
+        replaceUnicode(po["wxcfg"], cl.enabled(OptionUnicode));
+
+    if (cl.has(OptionDebug))
+        replaceDebug(po["wxcfg"], cl.enabled(OptionDebug));
+
+    if (cl.has(OptionStatic))
+        replaceStatic(po["wxcfg"], cl.enabled(OptionStatic));
+
+    /// clang uses the gcc configurations, clang-cl the vc ones
+    if (cl.has(OptionCompiler))
+    {
+        static const char* configurations[] = { "gcc", "dmc", "vc", "wat", "bcc", "gcc", "vc" };
+        replaceCompilerIfFound(po["wxcfg"], configurations[cl.compiler()]);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+
+/// Returns true if the requested outputs need the flags, and so setup.h, to be resolved
+bool needsFullProcess(const CmdLineOptions& cl)
+{
+    return cl.has(OptionCflags) ||
+           cl.has(OptionCxxflags) ||
+           cl.has(OptionCppflags) ||
+           cl.has(OptionLibs) ||
+           cl.has(OptionRuntimeDeps) ||
+           cl.has(OptionStage) ||
+           cl.has(OptionRcflags) ||
+           cl.has(OptionVariable) ||
+           cl.has(OptionDefineVariable);
+}
+
+/// Runs the compiler backend, evaluating only what the requested outputs need
+template <class T>
+void processCompiler(T& compiler, Options& po, const CmdLineOptions& cl)
+{
+    TraceSpan span("backend", "compiler", compiler.getName());
+    if (needsFullProcess(cl))
+    {
+        compiler.process(po, cl);
+        g_timing.mark("process_3");
+    }
+    else
+    {
+        compiler.processInfo(po);
+        g_timing.mark("process");
+    }
+}
+
+void detectCompiler(RunContext& ctx, Options& po, const CmdLineOptions& cl)
+{
+    // input example of po["wxcfg"]:
+    // gcc_dll\\mswud
+    // vc_lib\\msw
+
+    // clang uses the libraries of the MinGW and VC configurations
+    bool driver = cl.has(OptionCompiler);
+    if (po["wxcfg"].find("gcc_") != std::string::npos && driver && cl.compiler() == DriverClang)
+    {
+        CompilerClang compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else if (po["wxcfg"].find("vc_") != std::string::npos && driver && cl.compiler() == DriverClangCL)
+    {
+        CompilerClangCL compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else if (po["wxcfg"].find("gcc_") != std::string::npos)
+    {
+        CompilerMinGW compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else if (po["wxcfg"].find("dmc_") != std::string::npos)
+    {
+        CompilerDMC compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else if (po["wxcfg"].find("vc_") != std::string::npos)
+    {
+        CompilerVC compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else if (po["wxcfg"].find("wat_") != std::string::npos)
+    {
+        CompilerWAT compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else if (po["wxcfg"].find("bcc_") != std::string::npos)
+    {
+        CompilerBCC compiler(ctx);
+        processCompiler(compiler, po, cl);
+        return;
+    }
+    else
+    {
+        // TODO: this never reaches thanks to the new autodetection algorithm
+
+        throw WxConfigException(WxConfigError::NoCompiler,
+                                "No supported compiler has been detected in the configuration '" + po["wxcfg"] + "'.",
+                                "\nThe specified wxcfg must start with a 'gcc_', 'dmc_' or 'vc_'\n"
+                                "to be successfully detected.\n");
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+void validatePrefix(RunContext& ctx, const std::string& prefix)
+{
+    TraceSpan span("validatePrefix", "prefix", prefix);
+    // tests if prefix is a valid dir. checking if there is an \include\wx\wx.h
+    const std::string testfile = prefix + PATH_SEP "include" PATH_SEP "wx" PATH_SEP "wx.h";
+    if (!ctx.files.exists(testfile))
+    {
+        throw WxConfigException(WxConfigError::PrefixNotFound,
+                                "wxWidgets hasn't been found installed at '" + prefix + "'.",
+                                "\nPlease use the --prefix flag (as in wx-config --prefix=C:\\wxWidgets)\n"
+                                "or set the environment variable WXWIN (as in WXWIN=C:\\wxWidgets)\n"
+                                "to specify where is your installation of wxWidgets.\n");
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+
+bool validateConfiguration(RunContext& ctx, const std::string& wxcfgfile, const std::string& wxcfgsetuphfile,
+                           bool throwIfError = true)
+{
+    TraceSpan span("validateConfiguration", "file", wxcfgfile);
+    bool isBuildCfgOpen = ctx.files.exists(wxcfgfile);
+    bool isSetupHOpen = ctx.files.exists(wxcfgsetuphfile);
+
+    if (!isBuildCfgOpen && throwIfError)
+    {
+        if (!isSetupHOpen)
+        {
+            throw WxConfigException(WxConfigError::SetupHNotFound,
+                                    "No valid setup.h of wxWidgets has been found at location: " + wxcfgsetuphfile,
+                                    "\n" + g_hintWxcfg);
+        }
+
+        throw WxConfigException(WxConfigError::ConfigurationNotFound,
+                                "No valid configuration of wxWidgets has been found at location: " + wxcfgfile,
+                                "\n" + g_hintWxcfg);
+    }
+    return isBuildCfgOpen && isSetupHOpen;
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// Builds the output of the run, written to the console all at once, and gives the flags
+/// asked for in the result
+void outputFlags(RunContext& ctx, Options& po, const CmdLineOptions& cl, WxConfigResult& result)
+{
+    FlagBuilder out(result.output, 4096);
+
+    if (cl.has(OptionVariable))
+    {
+        out << po["variable"];
+        return;
+    }
+    if (cl.has(OptionCc))
+        out << po["cc"];
+    if (cl.has(OptionCxx))
+        out << po["cxx"];
+    if (cl.has(OptionLd))
+        out << po["ld"];
+    if (cl.has(OptionCflags) || cl.has(OptionCxxflags) || cl.has(OptionCppflags))
+    {
+        result.cflags = po["cflags"];
+        result.cflagArgs.swap(ctx.cflagArgs);
+        out << result.cflags << "\n";
+    }
+    if (cl.has(OptionLibs))
+    {
+        result.libs = po["libs"];
+        result.libArgs.swap(ctx.libArgs);
+        out << result.libs << "\n";
+    }
+    if (cl.has(OptionRcflags))
+    {
+        result.rcflags = po["rcflags"];
+        result.rcflagArgs.swap(ctx.rcflagArgs);
+        out << result.rcflags << "\n";
+    }
+    if (cl.has(OptionRuntimeDeps) || cl.has(OptionStage))
+        result.runtimeDeps = po["runtime-deps"];
+    if (cl.has(OptionRuntimeDeps))
+        out << result.runtimeDeps;
+    if (cl.has(OptionRelease) && cl.view(OptionRelease).length() == 0)
+        out << po["release"];
+    if (cl.has(OptionVersion))
+        out << po["version"];
+    if (cl.has(OptionBasename))
+    {
+        result.basename = po["basename"];
+        out << result.basename;
+    }
+
+#if 0 // not implemented
+    if (cl.keyExists("--version=")) // incomplete
+        std::cout << po["version="];
+    if (cl.keyExists("--ld")) // incomplete
+        std::cout << po["ld"];
+    if (cl.keyExists("--rezflags"))
+        std::cout << po["rezflags"];
+    if (cl.keyExists("--linkdeps"))
+        std::cout << po["linkdeps"];
+    if (cl.keyExists("--version-full"))
+        std::cout << po["version-full"];
+    if (cl.keyExists("--exec-prefix="))
+        std::cout << po["exec-prefix="];
+    if (cl.keyExists("--toolkit"))
+        std::cout << po["toolkit"];
+    if (cl.keyExists("--list"))
+        std::cout << po["list"];
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------
+
+/// True for the paths on a network drive, where each request to the file system is a round trip
+bool isRemotePath(const std::string& path)
+{
+#ifdef _WIN32
+    if (path.size() >= 2 && (path[0] == '\\' || path[0] == '/') && path[1] == path[0])
+        return true;
+    if (path.size() >= 2 && path[1] == ':')
+    {
+        char root[] = "X:\\";
+        root[0] = path[0];
+        return GetDriveTypeA(root) == DRIVE_REMOTE;
+    }
+    return false;
+#elif defined(__linux__)
+    struct statfs fs;
+    if (statfs(path.c_str(), &fs) != 0)
+        return false;
+
+    switch ((unsigned long)fs.f_type & 0xFFFFFFFFUL)
+    {
+        case 0x6969UL:          // NFS
+        case 0x517BUL:          // SMB
+        case 0xFF534D42UL:      // CIFS
+        case 0xFE534D42UL:      // SMB2
+        case 0x01021997UL:      // 9P
+        case 0x65735546UL:      // FUSE, as sshfs
+            return true;
+    }
+    return false;
+#else
+    return false;
+#endif
+}
+
+/// Files of the configuration: build.cfg, setup.h, and the config.* of its compiler, named
+/// by the start of the configuration (gcc_dll -> config.gcc)
+void configurationFiles(const std::string& prefix, const std::string& wxcfg, std::vector<std::string>& files)
+{
+    files.push_back(prefix + PATH_SEP "lib" PATH_SEP + wxcfg + PATH_SEP "build.cfg");
+    files.push_back(prefix + PATH_SEP "lib" PATH_SEP + wxcfg + PATH_SEP "wx" PATH_SEP "setup.h");
+    size_t underscore = wxcfg.find('_');
+    if (underscore != std::string::npos)
+        files.push_back(prefix + PATH_SEP "build" PATH_SEP "msw" PATH_SEP "config." + wxcfg.substr(0, underscore));
+}
+
+/// Requests at once what the resolution is going to read in each prefix: wx.h, and the
+/// files of the configuration asked for, or else of the default one tried before the
+/// autodetection. With several prefixes, all of them may be read before one is found:
+/// the setup.h the autodetection probes are requested too
+void prefetchInputs(RunContext& ctx, const std::vector<std::string>& prefixes, const std::string& wxcfg,
+                    bool autodetect, const CmdLineOptions& cl)
+{
+    Options guess;
+    guess["wxcfg"] = wxcfg;
+    normalizePath(guess["wxcfg"]);
+    checkAdditionalFlags(guess, cl);
+
+    std::vector<std::string> candidates;
+    if (autodetect && prefixes.size() > 1)
+        configurationCandidates(guess["wxcfg"], cl, candidates);
+
+    std::vector<std::string> reads, probes;
+    for (size_t i = 0; i < prefixes.size(); ++i)
+    {
+        configurationFiles(prefixes[i], guess["wxcfg"], reads);
+        probes.push_back(prefixes[i] + PATH_SEP "include" PATH_SEP "wx" PATH_SEP "wx.h");
+        for (size_t j = 0; j < candidates.size(); ++j)
+            probes.push_back(prefixes[i] + PATH_SEP "lib" PATH_SEP + candidates[j] + PATH_SEP "wx" PATH_SEP "setup.h");
+    }
+    ctx.files.prefetch(reads, probes);
+}
+
+/// Splits a search path of prefixes separated by ';', or ':' but on Windows where it
+/// follows the drive letters. A single prefix is returned as is
+void splitSearchPath(const std::string& path, std::vector<std::string>& prefixes)
+{
+#ifdef _WIN32
+    const char* separators = ";";
+#else
+    const char* separators = ";:";
+#endif
+    size_t begin = 0;
+    while (begin <= path.size())
+    {
+        size_t end = path.find_first_of(separators, begin);
+        if (end == std::string::npos)
+            end = path.size();
+        if (end > begin)
+            prefixes.push_back(path.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    if (prefixes.empty())
+        prefixes.push_back(path);
+
+    for (size_t i = 0; i < prefixes.size(); ++i)
+        normalizePath(prefixes[i], true);
+}
+
+/// True if the configuration is of the release: X.Y, or X.Y.Z
+bool hasRelease(RunContext& ctx, Options& po, const std::string& release)
+{
+    BuildFileOptions cfg(ctx, po["wxcfgfile"]);
+    std::string version = cfg["WXVER_MAJOR"] + "." + cfg["WXVER_MINOR"];
+    if (std::count(release.begin(), release.end(), '.') > 1)
+        version += "." + cfg["WXVER_RELEASE"];
+    return version == release;
+}
+
+/// Finds the configuration in the prefix po["prefix"]: the one asked for, or else the
+/// autodetected one, which must be of the release asked for if any. Throws if none
+void resolveConfiguration(RunContext& ctx, const WxConfigQuery& query, const CmdLineOptions& cl, Options& po)
+{
+    validatePrefix(ctx, po["prefix"]);
+    g_timing.mark("validatePrefix");
+
+    {
+        TraceSpan span("configuration");
+        if (cl.has(OptionWxcfg))
+            po["wxcfg"] = cl.value(OptionWxcfg);
+        else if (!query.wxcfg.empty() && !cl.has(OptionPrefix))
+            po["wxcfg"] = query.wxcfg;
+        else
+        {
+            // Try if something valid can be found trough deriving checkAdditionalFlags() first
+            po["wxcfg"] = "gcc_dll" PATH_SEP "msw";
+            po["wxcfgfile"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + po["wxcfg"] + PATH_SEP "build.cfg";
+            po["wxcfgsetuphfile"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + po["wxcfg"] + PATH_SEP "wx" PATH_SEP "setup.h";
+            checkAdditionalFlags(po, cl);
+
+            if (!validateConfiguration(ctx, po["wxcfgfile"], po["wxcfgsetuphfile"], false))
+                autodetectConfiguration(ctx, po, cl);    // important function
+        }
+
+        normalizePath(po["wxcfg"]);
+        checkAdditionalFlags(po, cl);
+        if (ctx.prefetch == RunContext::PrefetchAlways)
+        {
+            std::vector<std::string> reads;
+            configurationFiles(po["prefix"], po["wxcfg"], reads);
+            ctx.files.prefetch(reads, std::vector<std::string>());
+        }
+        g_timing.mark("autodetect");
+    }
+    po["wxcfgfile"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + po["wxcfg"] + PATH_SEP "build.cfg";
+    po["wxcfgsetuphfile"] = po["prefix"] + PATH_SEP "lib" PATH_SEP + po["wxcfg"] + PATH_SEP "wx" PATH_SEP "setup.h";
+    validateConfiguration(ctx, po["wxcfgfile"], po["wxcfgsetuphfile"]);
+    g_timing.mark("validateConfiguration");
+
+    std::string release = cl.value(OptionRelease);
+    if (!release.empty() && !hasRelease(ctx, po, release))
+        throw WxConfigException(WxConfigError::PrefixNotFound,
+                                "wxWidgets " + release + " hasn't been found installed at '" + po["prefix"] + "'.",
+                                "\nThe configuration " + po["wxcfg"] + " found there is of another release.\n");
+}
+
+/// Tries the prefixes of the search path in order, the first one with the configuration
+/// winning. The files of all of them are requested at once beforehand, if prefetching
+void selectPrefix(RunContext& ctx, const WxConfigQuery& query, const CmdLineOptions& cl,
+                  const std::vector<std::string>& prefixes, Options& po)
+{
+    if (prefixes.size() == 1)
+    {
+        po["prefix"] = prefixes[0];
+        resolveConfiguration(ctx, query, cl, po);
+        return;
+    }
+
+    std::string errors;
+    WxConfigError::Code code = WxConfigError::None;
+    for (size_t i = 0; i < prefixes.size(); ++i)
+    {
+        TraceSpan span("prefix", "prefix", prefixes[i]);
+
+        // The warnings of the prefixes not chosen are dropped with them
+        size_t messages = ctx.messages.size();
+        Options attempt;
+        attempt["prefix"] = prefixes[i];
+        try
+        {
+            resolveConfiguration(ctx, query, cl, attempt);
+            po = attempt;
+            return;
+        }
+        catch (const WxConfigException& e)
+        {
+            ctx.messages.erase(ctx.messages.begin() + messages, ctx.messages.end());
+            if (i == 0)
+                code = e.error().code;
+            errors += "  " + prefixes[i] + ": " + e.error().text + "\n";
+        }
+    }
+
+    throw WxConfigException(code, "None of the prefixes of the search path has the configuration asked for.",
+                            "\n" + errors);
+}
+
+// -------------------------------------------------------------------------------------------------
 
+/// Resolves a query in the given context: the prefix, the configuration (autodetected
+/// if needed), then the flags. The errors that stop it are given in result.error
+void resolveQuery(RunContext& ctx, const WxConfigQuery& query, WxConfigResult& result)
+{
+    std::vector<std::string> args(1, "wx-config");
+    args.insert(args.end(), query.args.begin(), query.args.end());
+    CmdLineOptions cl(args);
 
-    // reads the first setup.h it founds
-    bool found = false;
-    for(std::vector<std::string>::const_iterator it = cfgs.begin(); it != cfgs.end(); ++it)
+    /// Program options
+    Options po;
+
+    try
     {
-        std::string file = po["prefix"] + "\\lib\\" + *it + "\\wx\\setup.h";
-        std::ifstream setupH(file.c_str());
-        if (setupH.is_open())
+        if (cl.error() != CmdLineOptions::ErrorNone)
+            throw WxConfigException(WxConfigError::InvalidOption, cl.errorText() + ".");
+        if (!cl.hasValidArgs())
+            throw WxConfigException(WxConfigError::InvalidOption, "No recognised option in the query.");
+
+        checkEasyMode(ctx, cl);
+        checkProfile(ctx, cl);
+
+        /// A search path of prefixes
+        std::vector<std::string> prefixes;
+        splitSearchPath(cl.has(OptionPrefix) ? cl.value(OptionPrefix) : query.wxwin, prefixes);
+        result.prefix = prefixes[0];
+
+        /// Only the round trips to a network drive are worth the threads: on local disks,
+        /// a search path is faster probed in order
+        if (ctx.prefetch == RunContext::PrefetchAuto)
         {
-            if (!found)
-            {
-                po["wxcfg"] = *it;
-                found = true;
-            }
+            ctx.prefetch = RunContext::PrefetchNever;
+            for (size_t i = 0; i < prefixes.size(); ++i)
+                if (isRemotePath(prefixes[i]))
+                    ctx.prefetch = RunContext::PrefetchAlways;
+        }
+        if (ctx.prefetch == RunContext::PrefetchAlways)
+        {
+            if (cl.has(OptionWxcfg))
+                prefetchInputs(ctx, prefixes, cl.value(OptionWxcfg), false, cl);
+            else if (!query.wxcfg.empty() && !cl.has(OptionPrefix))
+                prefetchInputs(ctx, prefixes, query.wxcfg, false, cl);
             else
-            {
-                std::cerr << g_tokWarning << "Multiple compiled configurations of wxWidgets have been detected." << std::endl;
-                std::cerr << "Using first detected version by default." << std::endl;
-                std::cerr << std::endl;
-                std::cerr << "Please use the --wxcfg flag (as in wx-config --wxcfg=gcc_dll\\mswud)" << std::endl;
-                std::cerr << "or set the environment variable WXCFG (as in WXCFG=gcc_dll\\mswud)" << std::endl;
-                std::cerr << "to specify which configuration exactly you want to use." << std::endl;
-                return;
-            }
+                prefetchInputs(ctx, prefixes, "gcc_dll" PATH_SEP "msw", true, cl);
         }
-    }
 
-    if (!po.keyExists("wxcfg"))
+        selectPrefix(ctx, query, cl, prefixes, po);
+        result.prefix = po["prefix"];
+        result.wxcfg = po["wxcfg"];
+
+        detectCompiler(ctx, po, cl);
+
+        g_trace.begin("output");
+        outputFlags(ctx, po, cl, result);
+        g_timing.mark("output");
+        g_trace.end();
+    }
+    catch (const WxConfigException& e)
     {
-        // TODO: this never reaches thanks to the new autodetection algorithm
+        result.error = e.error();
+    }
 
-        std::cout << g_tokError << "No setup.h file has been auto-detected." << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "Please use the --wxcfg flag (as in wx-config --wxcfg=gcc_dll\\mswud)" << std::endl;
-        std::cerr << "or set the environment variable WXCFG (as in WXCFG=gcc_dll\\mswud)" << std::endl;
-        std::cerr << "to specify which configuration exactly you want to use." << std::endl;
+    result.messages.swap(ctx.messages);
+}
 
-        exit(1);
+WxConfigResult wxConfigResolve(const WxConfigQuery& query)
+{
+    RunContext ctx;
+    WxConfigResult result;
+    resolveQuery(ctx, query, result);
+    return result;
+}
+
+WxConfigCache::WxConfigCache() : m_inputs(new SharedInputs)
+{
+}
+
+WxConfigCache::~WxConfigCache()
+{
+    delete m_inputs;
+}
+
+WxConfigResult wxConfigResolve(const WxConfigQuery& query, WxConfigCache& cache)
+{
+    RunContext ctx(cache.m_inputs);
+    WxConfigResult result;
+    resolveQuery(ctx, query, result);
+    return result;
+}
+
+/// Prints the messages and the error of a resolution as wx-config always did: the errors
+/// to stdout, the warnings and the hints to stderr. Returns false on a fatal error
+bool printMessages(const WxConfigResult& result)
+{
+    for (std::vector<WxConfigMessage>::const_iterator it = result.messages.begin(); it != result.messages.end(); ++it)
+    {
+        if (it->severity == WxConfigMessage::Warning)
+            std::cerr << g_tokWarning << it->text << std::endl << it->hint;
+        else
+            std::cout << g_tokError << it->text << std::endl << it->hint;
     }
+
+    if (result.ok())
+        return true;
+
+    std::cout << g_tokError << result.error.text << std::endl;
+    std::cerr << result.error.hint;
+    return false;
 }
 
 // -------------------------------------------------------------------------------------------------
 
-void checkAdditionalFlags(Options& po, const CmdLineOptions& cl)
+/// Reports written when the run ends: at exit, or right before exec replaces the process
+std::vector<void (*)()> g_reports;
+
+/// Runs the reports in the reverse order of their registration, like atexit() does
+void runReports()
 {
-    /// Modifies wxcfg as 'vc[cpu]_[dll|lib][CFG]\[msw|base][univ][u][d]' accordingly
-    /// or 'gcc_[dll|lib][CFG]\[msw|base][univ][u][d]'
+    for (size_t i = g_reports.size(); i > 0; --i)
+        g_reports[i - 1]();
+    g_reports.clear();
+}
 
-    if (cl.keyExists("--universal"))
-    {
-        if (cl.keyValue("--universal") == "no")
-            replaceUniv(po["wxcfg"], false);
-        else if (cl.keyValue("--universal") == "yes" || cl.keyValue("--universal").empty())
-            replaceUniv(po["wxcfg"], true);
-                }
+void addReport(void (*report)())
+{
+    if (g_reports.empty())
+        atexit(runReports);
+    g_reports.push_back(report);
+}
 
-    if (cl.keyExists("--unicode"))
-    {
-        if (cl.keyValue("--unicode") == "no")
-            replaceUnicode(po["wxcfg"], false);
-        else if (cl.keyValue("--unicode") == "yes" || cl.keyValue("--unicode").empty())
-            replaceUnicode(po["wxcfg"], true);
-            }
+// -------------------------------------------------------------------------------------------------
 
-    if (cl.keyExists("--debug"))
+/// Removes 'exec' and '-- tool args...' from the command line, leaving the options of
+/// wx-config in argv, and the tool and its arguments in toolArgs. Returns the new argc
+int splitExecArgs(int argc, char* argv[], std::vector<char*>& toolArgs)
+{
+    int separator = 2;
+    while (separator < argc && strcmp(argv[separator], "--") != 0)
+        ++separator;
+
+    if (separator + 1 >= argc)
     {
-        if (cl.keyValue("--debug") == "no")
-            replaceDebug(po["wxcfg"], false);
-        else if (cl.keyValue("--debug") == "yes" || cl.keyValue("--debug").empty())
-            replaceDebug(po["wxcfg"], true);
-        }
+        std::cout << g_tokError << "No tool to run, use: wx-config exec [options] -- TOOL [ARGS...]" << std::endl;
+        exit(1);
+    }
+
+    toolArgs.assign(argv + separator + 1, argv + argc);
+    for (int i = 2; i < separator; ++i)
+        argv[i - 1] = argv[i];
+    return separator - 1;
+}
+
+#ifdef _WIN32
+/// Quotes an argument for CreateProcess(), following the parsing rules of the C runtime:
+/// backslashes are only special before a double quote
+std::string quoteArgument(const std::string& arg)
+{
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+        return arg;
 
-    if (cl.keyExists("--static"))
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (std::string::const_iterator c = arg.begin(); c != arg.end(); ++c)
     {
-        if (cl.keyValue("--static") == "no")
-            replaceStatic(po["wxcfg"], false);
-        else if (cl.keyValue("--static") == "yes" || cl.keyValue("--static").empty())
-            replaceStatic(po["wxcfg"], true);
+        if (*c == '\\')
+            ++backslashes;
+        else
+        {
+            if (*c == '"')
+                quoted.append(backslashes + 1, '\\');
+            backslashes = 0;
         }
+        quoted += *c;
+    }
+    quoted.append(backslashes, '\\');
+    quoted += '"';
+    return quoted;
+}
+#endif
+
+/// Runs the tool with the flags asked for appended to its arguments, one argument per
+/// flag, without a shell in between. On POSIX the tool replaces wx-config; on Windows
+/// wx-config waits for it and returns its exit code
+int execTool(const WxConfigResult& result, const std::vector<char*>& toolArgs)
+{
+    std::vector<std::string> args(toolArgs.begin(), toolArgs.end());
+    args.insert(args.end(), result.cflagArgs.begin(), result.cflagArgs.end());
+    args.insert(args.end(), result.libArgs.begin(), result.libArgs.end());
+    args.insert(args.end(), result.rcflagArgs.begin(), result.rcflagArgs.end());
+    g_timing.mark("exec");
 
-    if (cl.keyExists("--compiler"))
+#ifdef _WIN32
+    std::string cmdLine;
+    for (std::vector<std::string>::const_iterator it = args.begin(); it != args.end(); ++it)
+        cmdLine += (it == args.begin() ? "" : " ") + quoteArgument(*it);
+
+    STARTUPINFOA si;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    PROCESS_INFORMATION pi;
+    std::vector<char> buffer(cmdLine.begin(), cmdLine.end());
+    buffer.push_back('\0');
+    if (!CreateProcessA(NULL, &buffer[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi))
     {
-        if (cl.keyValue("--compiler") == "gcc")
-            replaceCompilerIfFound(po["wxcfg"], "gcc");
-        else if (cl.keyValue("--compiler") == "dmc")
-            replaceCompilerIfFound(po["wxcfg"], "dmc");
-        else if (cl.keyValue("--compiler") == "vc")
-            replaceCompilerIfFound(po["wxcfg"], "vc");
-        else if (cl.keyValue("--compiler") == "wat")
-            replaceCompilerIfFound(po["wxcfg"], "wat");
-        else if (cl.keyValue("--compiler") == "bcc")
-            replaceCompilerIfFound(po["wxcfg"], "bcc");
+        std::cout << g_tokError << "Unable to run '" << args[0] << "' (error " << GetLastError() << ")." << std::endl;
+        return 1;
     }
+    CloseHandle(pi.hThread);
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD code = 1;
+    GetExitCodeProcess(pi.hProcess, &code);
+    CloseHandle(pi.hProcess);
+    return code;
+#else
+    std::vector<char*> argv;
+    for (std::vector<std::string>::iterator it = args.begin(); it != args.end(); ++it)
+        argv.push_back(&(*it)[0]);
+    argv.push_back(NULL);
+
+    runReports();
+    fflush(stdout);
+    execvp(argv[0], &argv[0]);
+
+    std::cout << g_tokError << "Unable to run '" << args[0] << "': " << strerror(errno) << "." << std::endl;
+    return 1;
+#endif
 }
 
 // -------------------------------------------------------------------------------------------------
 
+/// Writes the file through a temporary one renamed over it, so that a build reading it
+/// never sees it partially written. A file with the same contents is left untouched, so
+/// that the targets depending on it are not rebuilt. Returns false on error
+bool writeFileAtomically(const std::string& path, const std::string& contents, bool& changed)
+{
+    changed = false;
+    MappedFile current;
+    if (current.open(path))
+    {
+        TextView text = current.text();
+        if (text.length() == contents.size() && memcmp(text.begin, contents.data(), contents.size()) == 0)
+            return true;
+    }
+
+    char suffix[32];
+#ifdef _WIN32
+    sprintf(suffix, ".tmp%lu", (unsigned long)GetCurrentProcessId());
+#else
+    sprintf(suffix, ".tmp%lu", (unsigned long)getpid());
+#endif
+    std::string temp = path + suffix;
+
+    FILE* file = fopen(temp.c_str(), "wb");
+    bool ok = file != NULL;
+    if (ok)
+    {
+        ok = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+        ok = fclose(file) == 0 && ok;
+    }
+#ifdef _WIN32
+    ok = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = ok && rename(temp.c_str(), path.c_str()) == 0;
+#endif
+    if (!ok)
+    {
+        remove(temp.c_str());
+        std::cout << g_tokError << "Unable to write '" << path << "'." << std::endl;
+        return false;
+    }
+
+    changed = true;
+    return true;
+}
 
-void detectCompiler(Options& po, const CmdLineOptions& cl)
+/// What stat() tells of a file, compared to notice that it was rewritten or replaced
+struct FileStamp
 {
-    // input example of po["wxcfg"]:
-    // gcc_dll\\mswud
-    // vc_lib\\msw
+    FileStamp(const std::string& path) : exists(false), size(0), mtime(0), mtimeNs(0), inode(0)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return;
+
+        exists = true;
+        size = st.st_size;
+        mtime = st.st_mtime;
+#ifdef __linux__
+        mtimeNs = st.st_mtim.tv_nsec;
+#endif
+        inode = st.st_ino;
+    }
 
-    if (po["wxcfg"].find("gcc_") != std::string::npos)
+    bool operator==(const FileStamp& other) const
     {
-        CompilerMinGW compiler;
-        compiler.process(po, cl);
-        return;
+        return exists == other.exists && size == other.size && mtime == other.mtime &&
+               mtimeNs == other.mtimeNs && inode == other.inode;
     }
-    else if (po["wxcfg"].find("dmc_") != std::string::npos)
+
+    bool exists;
+    unsigned long size;
+    unsigned long mtime;
+    unsigned long mtimeNs;
+    unsigned long inode;
+};
+
+/// Puts the file in the directory as a hardlink, which costs no copy, or else (another
+/// volume, a file system without them) as a copy with the same modification time: a
+/// reflink where the file system shares blocks (FICLONE on Linux, CopyFile on ReFS). A
+/// file there of the same size and time, as a hardlink or a previous copy is, is left
+/// as is. Returns false on error
+bool stageFile(const std::string& source, const std::string& dir, bool& staged)
+{
+    staged = false;
+    std::string target = dir + PATH_SEP + source.substr(source.find_last_of("\\/") + 1);
+    FileStamp from(source), to(target);
+    if (!from.exists)
     {
-        CompilerDMC compiler;
-        compiler.process(po, cl);
-        return;
+        std::cout << g_tokError << "Unable to stage '" << source << "': it doesn't exist." << std::endl;
+        return false;
     }
-    else if (po["wxcfg"].find("vc_") != std::string::npos)
+    if (to.exists && to.size == from.size && to.mtime == from.mtime)
+        return true;
+
+    remove(target.c_str());
+#ifdef _WIN32
+    /// CopyFile keeps the modification time, and clones the blocks on ReFS
+    bool ok = CreateHardLinkA(target.c_str(), source.c_str(), NULL) != 0 ||
+              CopyFileA(source.c_str(), target.c_str(), FALSE) != 0;
+#else
+    bool linked = link(source.c_str(), target.c_str()) == 0;
+    bool ok = linked;
+#ifdef FICLONE
+    if (!ok)
     {
-        CompilerVC compiler;
-        compiler.process(po, cl);
-        return;
+        int in = open(source.c_str(), O_RDONLY);
+        int out = in < 0 ? -1 : open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        ok = out >= 0 && ioctl(out, FICLONE, in) == 0;
+        if (out >= 0)
+            ok = close(out) == 0 && ok;
+        if (in >= 0)
+            close(in);
+        if (!ok)
+            remove(target.c_str());
     }
-    else if (po["wxcfg"].find("wat_") != std::string::npos)
+#endif
+    if (!ok)
     {
-        CompilerWAT compiler;
-        compiler.process(po, cl);
-        return;
+        MappedFile file;
+        FILE* copy = NULL;
+        if (file.open(source) && (copy = fopen(target.c_str(), "wb")) != NULL)
+        {
+            TextView text = file.text();
+            ok = fwrite(text.begin, 1, text.length(), copy) == text.length();
+            ok = fclose(copy) == 0 && ok;
+        }
     }
-    else if (po["wxcfg"].find("bcc_") != std::string::npos)
+    if (ok && !linked)
     {
-        CompilerBCC compiler;
-        compiler.process(po, cl);
-        return;
+        utimbuf times;
+        times.actime = time(NULL);
+        times.modtime = from.mtime;
+        ok = utime(target.c_str(), &times) == 0;
     }
-    else
+#endif
+    if (!ok)
     {
-        // TODO: this never reaches thanks to the new autodetection algorithm
-
-        std::cout << g_tokError << "No supported compiler has been detected in the configuration '" << po["wxcfg"] << "'." << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "The specified wxcfg must start with a 'gcc_', 'dmc_' or 'vc_'" << std::endl;
-        std::cerr << "to be successfully detected." << std::endl;
-
-        exit(1);
+        remove(target.c_str());
+        std::cout << g_tokError << "Unable to stage '" << source << "' into '" << dir << "'." << std::endl;
+        return false;
     }
-}
 
-// -------------------------------------------------------------------------------------------------
+    staged = true;
+    return true;
+}
 
-void validatePrefix(const std::string& prefix)
+/// Stages the files listed one per line, as given by --runtime-deps, into the directory,
+/// created if needed. Returns false on error
+bool stageFiles(const std::string& files, const std::string& dir)
 {
-    // tests if prefix is a valid dir. checking if there is an \include\wx\wx.h
-    const std::string testfile = prefix + "\\include\\wx\\wx.h";
-    std::ifstream prefixIsValid(testfile.c_str());
-    if (!prefixIsValid.is_open())
+    TraceSpan span("stage", "dir", dir);
+    FileStamp stamp(dir);
+#ifdef _WIN32
+    bool ok = stamp.exists || CreateDirectoryA(dir.c_str(), NULL) != 0;
+#else
+    bool ok = stamp.exists || mkdir(dir.c_str(), 0777) == 0;
+#endif
+    if (!ok)
     {
-        std::cout << g_tokError << "wxWidgets hasn't been found installed at '" << prefix << "'." << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "Please use the --prefix flag (as in wx-config --prefix=C:\\wxWidgets)" << std::endl;
-        std::cerr << "or set the environment variable WXWIN (as in WXWIN=C:\\wxWidgets)" << std::endl;
-        std::cerr << "to specify where is your installation of wxWidgets." << std::endl;
+        std::cout << g_tokError << "Unable to create the directory '" << dir << "'." << std::endl;
+        return false;
+    }
 
-        exit(1);
+    size_t begin = 0, end;
+    while ((end = files.find('\n', begin)) != std::string::npos)
+    {
+        bool changed;
+        bool staged = stageFile(files.substr(begin, end - begin), dir, changed);
+        ++g_stats.stagedFiles;
+        if (staged && !changed)
+            ++g_stats.stagedCurrent;
+        ok = staged && ok;
+        begin = end + 1;
     }
+    return ok;
 }
 
-// -------------------------------------------------------------------------------------------------
-
-bool validateConfiguration(const std::string& wxcfgfile, const std::string& wxcfgsetuphfile, bool exitIfError = true)
+void sleepMs(unsigned long ms)
 {
-    std::ifstream build_cfg(wxcfgfile.c_str());
-    std::ifstream setup_h(wxcfgsetuphfile.c_str());
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+#endif
+}
 
-    bool isBuildCfgOpen = build_cfg.is_open();
-    bool isSetupHOpen = setup_h.is_open();
+/// Waits for changes of a set of files. On Linux, inotify watches their directories, so
+/// that files replaced or created are also noticed; elsewhere, or if a directory can't
+/// be watched, the files are polled. Either way a change is confirmed by their stamps
+class FileWatcher
+{
+public:
+    enum
+    {
+        PollMs = 500,   ///< interval of the polling
+        SettleMs = 200  ///< quiet time before a change is reported, as rebuilds write in bursts
+    };
 
-    if (!isBuildCfgOpen && exitIfError)
+    FileWatcher(const std::vector<std::string>& files) : m_files(files), m_fd(-1)
     {
-        if (!isSetupHOpen && exitIfError)
+#ifdef __linux__
+        m_fd = inotify_init();
+        for (size_t i = 0; m_fd >= 0 && i < m_files.size(); ++i)
         {
-            std::cout << g_tokError << "No valid setup.h of wxWidgets has been found at location: " << wxcfgsetuphfile << std::endl;
-            std::cerr << std::endl;
-            std::cerr << "Please use the --wxcfg flag (as in wx-config --wxcfg=gcc_dll\\mswud)" << std::endl;
-            std::cerr << "or set the environment variable WXCFG (as in WXCFG=gcc_dll\\mswud)" << std::endl;
-            std::cerr << "to specify which configuration exactly you want to use." << std::endl;
-
-            exit(1);
+            std::string dir = m_files[i].substr(0, m_files[i].find_last_of("/\\"));
+            if (inotify_add_watch(m_fd, dir.empty() ? "/" : dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                  IN_CREATE | IN_DELETE | IN_ATTRIB | IN_DELETE_SELF) < 0)
+            {
+                close(m_fd);
+                m_fd = -1;
+            }
         }
+#endif
+    }
 
-        std::cout << g_tokError << "No valid configuration of wxWidgets has been found at location: " << wxcfgfile << std::endl;
-        std::cerr << std::endl;
-        std::cerr << "Please use the --wxcfg flag (as in wx-config --wxcfg=gcc_dll\\mswud)" << std::endl;
-        std::cerr << "or set the environment variable WXCFG (as in WXCFG=gcc_dll\\mswud)" << std::endl;
-        std::cerr << "to specify which configuration exactly you want to use." << std::endl;
+    ~FileWatcher()
+    {
+#ifdef __linux__
+        if (m_fd >= 0)
+            close(m_fd);
+#endif
+    }
 
-        exit(1);
+    /// Stamps of the files, in order
+    static void stamp(const std::vector<std::string>& files, std::vector<FileStamp>& stamps)
+    {
+        stamps.clear();
+        for (size_t i = 0; i < files.size(); ++i)
+            stamps.push_back(FileStamp(files[i]));
     }
-    return isBuildCfgOpen && isSetupHOpen;
-}
 
-// -------------------------------------------------------------------------------------------------
+    /// Waits until one of the files differs from its stamp (at once if it already does),
+    /// then until the files stop changing. Returns the first file found changed
+    std::string wait(const std::vector<FileStamp>& stamps)
+    {
+        std::string changed = findChange(stamps);
+        while (changed.empty())
+        {
+            waitEvents(PollMs);
+            changed = findChange(stamps);
+        }
 
-void outputFlags(Options& po, const CmdLineOptions& cl)
-{
-    /// Outputs flags to console
-    if (cl.keyExists("--variable"))
-    {
-        std::cout << po["variable"];
-        exit(0);
-    }
-    if (cl.keyExists("--cc"))
-        std::cout << po["cc"];
-    if (cl.keyExists("--cxx"))
-        std::cout << po["cxx"];
-    if (cl.keyExists("--ld"))
-        std::cout << po["ld"];
-    if (cl.keyExists("--cflags") || cl.keyExists("--cxxflags") || cl.keyExists("--cppflags"))
-        std::cout << po["cflags"] << std::endl;
-    if (cl.keyExists("--libs"))
-        std::cout << po["libs"] << std::endl;
-    if (cl.keyExists("--rcflags"))
-        std::cout << po["rcflags"] << std::endl;
-    if (cl.keyExists("--release"))
-        std::cout << po["release"];
-    if (cl.keyExists("--version"))
-        std::cout << po["version"];
-    if (cl.keyExists("--basename"))
-        std::cout << po["basename"];
+        std::vector<FileStamp> last, current;
+        stamp(m_files, current);
+        do
+        {
+            last.swap(current);
+            sleepMs(SettleMs);
+            waitEvents(0);
+            stamp(m_files, current);
+        } while (!(last == current));
 
-#if 0 // not implemented
-    if (cl.keyExists("--version=")) // incomplete
-        std::cout << po["version="];
-    if (cl.keyExists("--ld")) // incomplete
-        std::cout << po["ld"];
-    if (cl.keyExists("--rezflags"))
-        std::cout << po["rezflags"];
-    if (cl.keyExists("--linkdeps"))
-        std::cout << po["linkdeps"];
-    if (cl.keyExists("--version-full"))
-        std::cout << po["version-full"];
-    if (cl.keyExists("--exec-prefix="))
-        std::cout << po["exec-prefix="];
-    if (cl.keyExists("--toolkit"))
-        std::cout << po["toolkit"];
-    if (cl.keyExists("--list"))
-        std::cout << po["list"];
+        return changed;
+    }
+
+protected:
+    std::string findChange(const std::vector<FileStamp>& stamps) const
+    {
+        for (size_t i = 0; i < m_files.size(); ++i)
+            if (!(FileStamp(m_files[i]) == stamps[i]))
+                return m_files[i];
+        return "";
+    }
+
+    /// Waits for, and consumes, the events of the directories; sleeps when polling
+    void waitEvents(int pollMs)
+    {
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            pollfd pfd;
+            pfd.fd = m_fd;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, pollMs ? -1 : 0) > 0)
+            {
+                char buffer[4096];
+                if (read(m_fd, buffer, sizeof(buffer)) < 0 && errno != EINTR)
+                {
+                    close(m_fd);
+                    m_fd = -1;
+                }
+            }
+            return;
+        }
 #endif
+        if (pollMs)
+            sleepMs(pollMs);
+    }
+
+    std::vector<std::string> m_files;
+    int m_fd;   ///< inotify descriptor, -1 when polling
+};
+
+/// Keeps the output file of the query up to date: resolves the query again each time
+/// one of the files it read changes, and rewrites the output when it differs. A query
+/// only depends on what it read, so unrelated changes under the prefix are ignored; the
+/// files a resolution probed without reading them (the configurations the autodetection
+/// did not retain) are not watched. Runs until interrupted
+int watchQuery(const WxConfigQuery& query, const std::string& outputFile)
+{
+    std::vector<std::string> inputs;
+    std::vector<FileStamp> stamps;
+    for (;;)
+    {
+        /// the stamps are taken before resolving, so that a change during the resolution
+        /// is seen; the first round only learns the inputs, and resolves again
+        FileWatcher::stamp(inputs, stamps);
+
+        RunContext context;
+        WxConfigResult result;
+        resolveQuery(context, query, result);
+
+        bool changed = false;
+        if (printMessages(result) && writeFileAtomically(outputFile, result.output, changed) && changed)
+            std::cerr << "wx-config: '" << outputFile << "' updated." << std::endl;
+
+        std::vector<std::string> read;
+        context.files.readFiles(read);
+        if (read.empty())
+        {
+            std::cout << g_tokError << "No input file to watch." << std::endl;
+            return 1;
+        }
+        if (read != inputs)
+        {
+            inputs.swap(read);
+            continue;
+        }
+
+        FileWatcher watcher(inputs);
+        std::string file = watcher.wait(stamps);
+        std::cerr << "wx-config: '" << file << "' changed." << std::endl;
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
 
+/// The benchmarks include this file, and bring their own main(); a program linking the
+/// resolver (WXCONFIG_LIBRARY) calls wxConfigResolve()
+#if !defined(WXCONFIG_NO_MAIN) && !defined(WXCONFIG_LIBRARY)
 
+#ifndef _WIN32
+/// Without --prefix nor WXWIN, when the installation can't be located from the executable:
+/// no prefix is guessed. Returns the exit code
+int failWithoutPrefix()
+{
+    std::cout << g_tokError << "No wxWidgets installation given." << std::endl;
+    std::cerr << "\nPlease use the --prefix flag (as in wx-config --prefix=/opt/wxWidgets)\n"
+                 "or set the environment variable WXWIN (as in WXWIN=/opt/wxWidgets)\n"
+                 "to specify where is your installation of wxWidgets.\n";
+    return 1;
+}
+#endif
 
 int main(int argc, char* argv[])
 {
+    double argsStart = TimingTrace::now();
+
+    /// wx-config exec [options] -- tool args...
+    std::vector<char*> toolArgs;
+    if (argc > 1 && strcmp(argv[1], "exec") == 0)
+        argc = splitExecArgs(argc, argv, toolArgs);
+
     /// Command line options
     CmdLineOptions cl(argc, argv);
 
-    /// Program options
-    Options po;
-
     if (!cl.validArgs())
         return 1;
 
-    if (cl.keyExists("-v"))
+    if (cl.has(OptionTraceTiming) || (getenv("WXCONFIG_TRACE_TIMING") && strcmp(getenv("WXCONFIG_TRACE_TIMING"), "0") != 0))
+    {
+        g_timing.enable();
+        addReport(reportTiming);
+    }
+    if (cl.has(OptionStats))
+    {
+        g_stats.enabled = true;
+        addReport(reportStats);
+    }
+    if (cl.has(OptionTraceOut))
+    {
+        g_trace.enable(cl.value(OptionTraceOut));
+        addReport(writeTrace);
+    }
+    g_trace.begin("args", NULL, "", argsStart);
+    g_trace.end();
+    g_timing.mark("args");
+    g_trace.begin("prefix discovery");
+
+    if (cl.has(OptionRevision))
     {
         std::cout << "wx-config revision " << getSvnRevision() << " " << getSvnDate() << std::endl;
         return 0;
     }
 
-    checkEasyMode(cl);
+    WxConfigQuery query;
+    query.args.assign(argv + 1, argv + argc);
+    if (getenv("WXCFG"))
+        query.wxcfg = getenv("WXCFG");
 
-    if (cl.keyExists("--prefix"))
-        po["prefix"] = cl["--prefix"];
-    else if (getenv("WXWIN"))
-        po["prefix"] = getenv("WXWIN");
-    else
+    if (getenv("WXWIN"))
+        query.wxwin = getenv("WXWIN");
+    else if (!cl.has(OptionPrefix))
     {
 #ifdef _WIN32
         /// Assume that, like a *nix, we're installed in C:\some\path\bin,
@@ -2567,42 +5754,68 @@ int main(int argc, char* argv[])
         
         // Fix the ..
         GetFullPathName(libPath, length, libPath, NULL);
-        po["prefix"] = libPath;
+        query.wxwin = libPath;
         delete[] libPath;
+#elif defined(__linux__)
+        /// Same assumption, locating ourselves through /proc
+        char exePath[PATH_MAX];
+        ssize_t length = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+        if (length <= 0)
+            return failWithoutPrefix();
+
+        exePath[length] = '\0';
+        std::string libPath(exePath);
+        libPath.erase(libPath.rfind('/') + 1);
+        libPath += "..";
+
+        char resolved[PATH_MAX];
+        query.wxwin = realpath(libPath.c_str(), resolved) ? resolved : libPath.c_str();
 #else
-        po["prefix"] = "C:\\wxWidgets";
+        /// No portable way to locate the executable here
+        return failWithoutPrefix();
 #endif
     }
+    g_timing.mark("prefix discovery");
+    g_trace.end();
 
-    normalizePath(po["prefix"]);
+    if (cl.has(OptionWatch))
+    {
+        if (!cl.has(OptionOutput))
+        {
+            std::cout << g_tokError << "--watch needs an output file." << std::endl;
+            std::cerr << "Use --output=FILE, as in wx-config --watch --output=wx.flags --cflags" << std::endl;
+            return 1;
+        }
+        return watchQuery(query, cl.value(OptionOutput));
+    }
 
-    validatePrefix(po["prefix"]);
+    RunContext context;
+    g_reportedFiles = &context.files;
+    if (getenv("WXCONFIG_PREFETCH"))
+        context.prefetch = strcmp(getenv("WXCONFIG_PREFETCH"), "0") != 0 ? RunContext::PrefetchAlways : RunContext::PrefetchNever;
+    WxConfigResult result;
+    resolveQuery(context, query, result);
 
-    if (cl.keyExists("--wxcfg"))
-        po["wxcfg"] = cl["--wxcfg"];
-    else if (getenv("WXCFG") && !cl.keyExists("--prefix"))
-        po["wxcfg"] = getenv("WXCFG");
-    else
+    int code = 1;
+    if (printMessages(result))
     {
-        // Try if something valid can be found trough deriving checkAdditionalFlags() first
-        po["wxcfg"] = "gcc_dll\\msw";
-        po["wxcfgfile"] = po["prefix"] + "\\lib\\" + po["wxcfg"] + "\\build.cfg";
-        po["wxcfgsetuphfile"] = po["prefix"] + "\\lib\\" + po["wxcfg"] + "\\wx\\setup.h";
-        checkAdditionalFlags(po, cl);
-
-        if (!validateConfiguration(po["wxcfgfile"], po["wxcfgsetuphfile"], false))
-            autodetectConfiguration(po, cl);    // important function
+        bool changed;
+        if (cl.has(OptionStage) && !stageFiles(result.runtimeDeps, cl.value(OptionStage)))
+            code = 1;
+        else if (!toolArgs.empty())
+            code = execTool(result, toolArgs);
+        else if (cl.has(OptionOutput))
+            code = writeFileAtomically(cl.value(OptionOutput), result.output, changed) ? 0 : 1;
+        else
+        {
+            fwrite(result.output.data(), 1, result.output.size(), stdout);
+            fflush(stdout);
+            code = 0;
+        }
     }
 
-    normalizePath(po["wxcfg"]);
-    checkAdditionalFlags(po, cl);
-    po["wxcfgfile"] = po["prefix"] + "\\lib\\" + po["wxcfg"] + "\\build.cfg";
-    po["wxcfgsetuphfile"] = po["prefix"] + "\\lib\\" + po["wxcfg"] + "\\wx\\setup.h";
-    validateConfiguration(po["wxcfgfile"], po["wxcfgsetuphfile"]);
-    
-    detectCompiler(po, cl);
-    outputFlags(po, cl);    
-   
-    return 0;
+    /// The files of the run go with the context
+    runReports();
+    return code;
 }
-
+#endif
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Name:        wx-config-win.h
+// Purpose:     In-process API of wx-config-win
+// Created:     2026-10-19
+// Licence:     wxWidgets licence
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef WXCONFIG_WIN_H
+#define WXCONFIG_WIN_H
+
+#include <string>
+#include <vector>
+
+/// To resolve flags in process, compile wx-config-win.cpp with WXCONFIG_LIBRARY defined
+/// (no main(), and no replacement of the global operator new) and include this header.
+/// wxConfigResolve() uses no global state and never exits: it can be called any number
+/// of times, and gives the output of the same command line along with its errors.
+
+/// What to resolve: the options of the command line, and the environment it would see
+struct WxConfigQuery
+{
+    /// Options as on the command line, as in { "--cflags", "--libs", "base,net" }
+    std::vector<std::string> args;
+
+    /// Stand for the WXWIN and WXCFG environment variables, which are not read in process.
+    /// wxwin is used without --prefix, wxcfg without --wxcfg and --prefix
+    std::string wxwin;
+    std::string wxcfg;
+};
+
+/// A message of the resolution, printed by wx-config as it is printed here
+struct WxConfigMessage
+{
+    enum Severity
+    {
+        Warning,
+        Error
+    };
+
+    WxConfigMessage(Severity s = Error, const std::string& t = "", const std::string& h = "")
+        : severity(s), text(t), hint(h) {}
+
+    Severity severity;
+    std::string text;   ///< first line, without the "wx-config Error: " prefix
+    std::string hint;   ///< what to do about it, possibly several lines
+};
+
+/// The error that stopped a resolution
+struct WxConfigError : public WxConfigMessage
+{
+    enum Code
+    {
+        None,
+        InvalidOption,          ///< no recognised option in the query
+        PrefixNotFound,         ///< no include/wx/wx.h in the prefix
+        ConfigurationNotFound,  ///< no build.cfg for the configuration
+        SetupHNotFound,         ///< neither a build.cfg nor a setup.h for the configuration
+        NoConfigurationDetected,
+        NoCompiler,             ///< the configuration names no known compiler
+        InvalidVariable         ///< --define-variable without NAME=VALUE
+    };
+
+    WxConfigError(Code c = None, const std::string& t = "", const std::string& h = "")
+        : WxConfigMessage(Error, t, h), code(c) {}
+
+    Code code;
+};
+
+/// Outcome of a resolution
+struct WxConfigResult
+{
+    bool ok() const
+    {
+        return error.code == WxConfigError::None;
+    }
+
+    WxConfigError error;
+    std::vector<WxConfigMessage> messages;  ///< non fatal ones, in order
+
+    std::string output;     ///< exactly what wx-config writes to stdout
+    std::string prefix;     ///< the installation and configuration used
+    std::string wxcfg;
+    std::string cflags;     ///< each one only when asked for by the query
+    std::string libs;
+    std::string rcflags;
+
+    /// The same flags, one argument of the tool each, as exec mode passes them: a path
+    /// with spaces is one argument
+    std::vector<std::string> cflagArgs;
+    std::vector<std::string> libArgs;
+    std::vector<std::string> rcflagArgs;
+
+    std::string basename;
+    std::string runtimeDeps;    ///< the DLLs to run with, one absolute path per line
+};
+
+WxConfigResult wxConfigResolve(const WxConfigQuery& query);
+
+struct SharedInputs;
+
+/// The build.cfg, config.* and setup.h files parsed by the resolutions using the cache,
+/// kept for the next ones. Files are assumed not to change while the cache lives.
+/// Any number of threads can resolve concurrently with one cache: the files already
+/// parsed are read without locking, and only the first use of a file is serialized
+class WxConfigCache
+{
+public:
+    WxConfigCache();
+    ~WxConfigCache();
+
+private:
+    WxConfigCache(const WxConfigCache&);
+    WxConfigCache& operator=(const WxConfigCache&);
+
+    SharedInputs* m_inputs;
+
+    friend WxConfigResult wxConfigResolve(const WxConfigQuery& query, WxConfigCache& cache);
+};
+
+/// Same as above, parsing each file only once for all the resolutions using the cache
+WxConfigResult wxConfigResolve(const WxConfigQuery& query, WxConfigCache& cache);
+
+#endif // WXCONFIG_WIN_H